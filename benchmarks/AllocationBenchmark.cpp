@@ -0,0 +1,187 @@
+// Counts the memory allocations made while two serializers send messages back and forth (a
+// serialized ping-pong). Once the pools are warmed up, passing a task through a serializer and
+// through the executor should not allocate memory, even for tasks that don't fit into the inline
+// buffer of Task. Fails if there are allocations in the steady state, other than the pools growing
+// by a few slabs (free blocks left in the cache of one thread can make another thread take a new
+// slab); the number of slabs is bounded, so a leak still fails the run.
+//
+// Also checks that threads that only free blocks, and never allocate, hand back their blocks to the
+// pools when they exit.
+//
+// Usage: AllocationBenchmark [--executor=ws|tbb] [--threads=N] [--hops=N]
+
+#include "BenchmarkUtils.hpp"
+
+#include "tasks/BlockPool.hpp"
+#include "tasks/GlobalTaskExecutor.hpp"
+#include "tasks/TaskSerializer.hpp"
+#include "tasks/WorkStealingExecutor.hpp"
+#include "utils/CommandLine.hpp"
+
+#include "tbb/global_control.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+//! The number of calls to the global operator new
+std::atomic<std::uint64_t> numMallocs{0};
+} // namespace
+
+void* operator new(std::size_t size) {
+    numMallocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+// Our operator new allocates with std::malloc, so freeing with std::free is correct. GCC doesn't
+// know that the global operator new is replaced, and warns when it inlines the delete operators
+// next to a call to operator new.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+//! Two serializers sending a message back and forth; the message is too big for the inline buffer
+struct PingPong {
+    //! Data carried with each message, so that the task doesn't fit into the inline buffer of Task
+    struct Payload {
+        long values_[8];
+    };
+
+    TaskSerializer ping_;
+    TaskSerializer pong_;
+    TaskSerializer* serializers_[2]{&ping_, &pong_};
+    long numHops_{0};
+    std::atomic<long> numDone_{0};
+
+    explicit PingPong(TaskExecutorPtr executor)
+        : ping_(executor)
+        , pong_(executor) {}
+
+    //! Sends messages back and forth, for the given number of hops, and waits for them to finish
+    void run(long numHops) {
+        numHops_ = numHops;
+        numDone_.store(0);
+        send(0, 0, Payload{});
+        waitForCount(numDone_, 1);
+    }
+
+    void send(long hop, int target, Payload payload) {
+        serializers_[target]->enqueue([this, hop, target, payload]() mutable {
+            payload.values_[hop % 8]++;
+            if (hop + 1 < numHops_)
+                send(hop + 1, 1 - target, payload);
+            else
+                numDone_.store(1, std::memory_order_release);
+        });
+    }
+};
+
+//! Allocates blocks on this thread and frees them on threads that exit right after, a number of
+//! times; returns the number of slabs the pool needed. If the exiting threads keep some of the
+//! blocks, the pool keeps growing.
+std::uint64_t runFreeOnlyThreads() {
+    // A block size that nothing else uses, so that we count only our slabs
+    using Pool = BlockPool<448>;
+    constexpr std::size_t numBlocks = 4 * Pool::batchSize;
+    constexpr int numRounds = 20;
+    std::vector<void*> blocks(numBlocks);
+    for (int i = 0; i < numRounds; i++) {
+        for (auto& block : blocks)
+            block = Pool::allocate();
+        std::thread freer([&blocks] {
+            for (void* block : blocks)
+                Pool::deallocate(block);
+        });
+        freer.join();
+    }
+    return Pool::numSlabs();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string executorName = "ws";
+    int numThreads = 2;
+    long numHops = 1000000;
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (matchArg(argv[i], "--executor=", value))
+            executorName = value;
+        else if (matchArg(argv[i], "--threads=", value))
+            numThreads = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--hops=", value))
+            numHops = std::atol(value.c_str());
+        else {
+            fprintf(stderr, "Usage: %s [--executor=ws|tbb] [--threads=N] [--hops=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    numThreads = std::max(numThreads, 1);
+    numHops = std::max(numHops, 1L);
+
+    tbb::global_control threadsLimit(
+            tbb::global_control::max_allowed_parallelism, numThreads + 1);
+    TaskExecutorPtr executor;
+    if (executorName == "ws")
+        executor = std::make_shared<WorkStealingExecutor>(numThreads);
+    else if (executorName == "tbb")
+        executor = std::make_shared<GlobalTaskExecutor>(numThreads);
+    else {
+        fprintf(stderr, "Unknown executor: %s\n", executorName.c_str());
+        return 1;
+    }
+
+    std::unique_ptr<PingPong> pingPong{new PingPong(executor)};
+
+    // Warm up the pools, then count the allocations in the steady state
+    pingPong->run(numHops);
+    std::uint64_t mallocsBefore = numMallocs.load();
+    std::uint64_t poolAllocationsBefore = numBlockPoolSystemAllocations();
+    auto start = BenchClock::now();
+    pingPong->run(numHops);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+    std::uint64_t mallocs = numMallocs.load() - mallocsBefore;
+    std::uint64_t poolAllocations = numBlockPoolSystemAllocations() - poolAllocationsBefore;
+
+    printf("executor,threads,hops,seconds,hops_per_sec,mallocs,mallocs_per_hop,pool_allocations\n");
+    printf("%s,%d,%ld,%g,%.0f,%lu,%g,%lu\n", executorName.c_str(), numThreads, numHops,
+            duration.count(), numHops / duration.count(), (unsigned long)mallocs,
+            double(mallocs) / numHops, (unsigned long)poolAllocations);
+
+    if (mallocs != poolAllocations) {
+        fprintf(stderr, "%s: %lu allocations in the steady state\n", executorName.c_str(),
+                (unsigned long)(mallocs - poolAllocations));
+        return 1;
+    }
+    std::uint64_t maxPoolAllocations = 2 * std::uint64_t(numThreads);
+    if (poolAllocations > maxPoolAllocations) {
+        fprintf(stderr, "%s: the pools grew by %lu slabs in the steady state (max %lu)\n",
+                executorName.c_str(), (unsigned long)poolAllocations,
+                (unsigned long)maxPoolAllocations);
+        return 1;
+    }
+
+    // The blocks must come back from the freeing threads; allow for the ones cached on this thread
+    std::uint64_t freeOnlySlabs = runFreeOnlyThreads();
+    std::uint64_t maxFreeOnlySlabs = 4 + 2;
+    if (freeOnlySlabs > maxFreeOnlySlabs) {
+        fprintf(stderr, "%lu slabs for the blocks freed by exiting threads (max %lu)\n",
+                (unsigned long)freeOnlySlabs, (unsigned long)maxFreeOnlySlabs);
+        return 1;
+    }
+    return 0;
+}
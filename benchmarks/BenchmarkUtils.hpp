@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+//! Returns the current time, in nanoseconds
+inline std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            BenchClock::now().time_since_epoch())
+            .count();
+}
+
+//! The outcome of one benchmark run
+struct BenchmarkResult {
+    std::string benchmark_;
+    std::string executor_;
+    int threads_{0};
+    long ops_{0};
+    double seconds_{0};
+    std::int64_t p50Ns_{0};
+    std::int64_t p99Ns_{0};
+    std::int64_t p999Ns_{0};
+
+    double opsPerSec() const { return seconds_ > 0 ? ops_ / seconds_ : 0; }
+};
+
+//! Computes the given percentiles from latency samples (in ns), and stores them in the result
+inline void computePercentiles(std::vector<std::int64_t>& samples, BenchmarkResult& res) {
+    if (samples.empty())
+        return;
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) {
+        auto idx = std::size_t(p * double(samples.size() - 1) + 0.5);
+        return samples[std::min(idx, samples.size() - 1)];
+    };
+    res.p50Ns_ = at(0.50);
+    res.p99Ns_ = at(0.99);
+    res.p999Ns_ = at(0.999);
+}
+
+//! Prints benchmark results in CSV or JSON format (JSON Lines: one object per line)
+class ResultPrinter {
+public:
+    explicit ResultPrinter(bool json)
+        : json_(json) {}
+
+    void printHeader() {
+        if (!json_)
+            printf("benchmark,executor,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns\n");
+    }
+
+    void print(const BenchmarkResult& r) {
+        if (json_)
+            printf("{\"benchmark\":\"%s\",\"executor\":\"%s\",\"threads\":%d,\"ops\":%ld,"
+                   "\"seconds\":%.6f,\"ops_per_sec\":%.0f,\"p50_ns\":%lld,\"p99_ns\":%lld,"
+                   "\"p999_ns\":%lld}\n",
+                    r.benchmark_.c_str(), r.executor_.c_str(), r.threads_, r.ops_, r.seconds_,
+                    r.opsPerSec(), (long long)r.p50Ns_, (long long)r.p99Ns_,
+                    (long long)r.p999Ns_);
+        else
+            printf("%s,%s,%d,%ld,%.6f,%.0f,%lld,%lld,%lld\n", r.benchmark_.c_str(),
+                    r.executor_.c_str(), r.threads_, r.ops_, r.seconds_, r.opsPerSec(),
+                    (long long)r.p50Ns_, (long long)r.p99Ns_, (long long)r.p999Ns_);
+        fflush(stdout);
+    }
+
+private:
+    bool json_;
+};
+
+//! Waits until the given counter reaches the given value
+template <typename Counter>
+void waitForCount(const Counter& counter, long value) {
+    while (long(counter.load(std::memory_order_acquire)) < value)
+        std::this_thread::yield();
+}
@@ -0,0 +1,644 @@
+// Benchmarks for the executors and the serializers. Measures:
+//  - enqueue: throughput of enqueueing empty tasks on the executor, from as many producer threads
+//    as the executor has worker threads; latency is from enqueue to the start of the task
+//  - bulkenqueue: same as enqueue, but the producers enqueue the tasks in batches, with
+//    enqueueBulk()
+//  - serializer: throughput of a serialized section (a TaskSerializer), with 1..N producers;
+//    latency is from enqueue to the start of the task
+//  - sharedserializer: a SharedTaskSerializer with 1..N producers, one write for every 9 reads;
+//    each task spins for about one microsecond; latency is from enqueue to the start of the task
+//  - boundedserializer: a TaskSerializer with a small capacity and the suspend policy, with 2..N
+//    producers enqueueing concurrently; checks the depth, and that every task runs exactly once;
+//    latency is from enqueue to the start of the task
+//  - boundedfifo: same as boundedserializer, but the producers enqueue one at a time, under a
+//    lock; also checks that the suspended producers enter the serializer in FIFO order
+//  - pingpong: two serializers sending a message to each other; latency is per hop
+//  - staticpingpong: same as pingpong, but with StaticSerializer, on the concrete executor type
+//  - fanout: trees of tasks, where each inner node spawns children and waits for all of them to
+//    complete (fan-out / fan-in); latency is per tree
+//  - retryloop: a task keeps enqueueing itself until the tasks enqueued before it complete, like a
+//    philosopher retrying to get its forks; fails if the older tasks are starved; latency is per
+//    round
+//
+// Each benchmark runs for each of the given thread counts, and for each of the given executors.
+// Prints the results as CSV or as JSON Lines.
+//
+// Usage: ExecutorBenchmarks [--format=csv|json] [--executors=tbb,ws] [--threads=1,2,4,8]
+//                           [--benchmarks=enqueue,bulkenqueue,serializer,
+//                                         sharedserializer,boundedserializer,boundedfifo,
+//                                         pingpong,staticpingpong,fanout,retryloop]
+//                           [--ops=N]
+
+#include "BenchmarkUtils.hpp"
+
+#include "tasks/GlobalTaskExecutor.hpp"
+#include "tasks/SharedTaskSerializer.hpp"
+#include "tasks/StaticSerializer.hpp"
+#include "tasks/TaskSerializer.hpp"
+#include "tasks/WorkStealingExecutor.hpp"
+#include "utils/CommandLine.hpp"
+
+#include "tbb/global_control.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+//! Parameters for one benchmark run
+struct RunParams {
+    std::string executorName_;
+    TaskExecutorPtr executor_;
+    int threads_;
+    long ops_;
+};
+
+//! Starts 'numProducers' threads, each calling 'f(producerIdx)', and waits for them to finish
+template <typename F>
+void runProducers(int numProducers, F f) {
+    std::vector<std::thread> producers;
+    producers.reserve(numProducers);
+    for (int i = 0; i < numProducers; i++)
+        producers.emplace_back([&f, i] { f(i); });
+    for (auto& t : producers)
+        t.join();
+}
+
+#if TASKS_INSTRUMENTATION
+//! Prints the counters of an executor to stderr, keeping the results output clean
+void printCounters(const char* name, const ExecutorCountersSnapshot& c) {
+    fprintf(stderr,
+            "%s: enqueued %lu, executed %lu, max depth %ld, found busy %lu, "
+            "latency p50/p99 %ld/%ld ns, execution p50/p99 %ld/%ld ns\n",
+            name, (unsigned long)c.tasksEnqueued_, (unsigned long)c.tasksExecuted_,
+            long(c.maxDepth_), (unsigned long)c.busyEnqueues_,
+            long(c.queueLatency_.percentileNs(0.5)), long(c.queueLatency_.percentileNs(0.99)),
+            long(c.executionTime_.percentileNs(0.5)), long(c.executionTime_.percentileNs(0.99)));
+}
+#endif
+
+BenchmarkResult benchEnqueue(const RunParams& params) {
+    long opsPerProducer = params.ops_ / params.threads_;
+    long totalOps = opsPerProducer * params.threads_;
+    std::vector<std::int64_t> latencies(totalOps);
+    std::atomic<long> numDone{0};
+
+    auto start = BenchClock::now();
+    runProducers(params.threads_, [&](int producerIdx) {
+        std::int64_t* slots = &latencies[producerIdx * opsPerProducer];
+        for (long i = 0; i < opsPerProducer; i++) {
+            std::int64_t* slot = slots + i;
+            std::atomic<long>* done = &numDone;
+            std::int64_t enqueueTime = nowNs();
+            params.executor_->enqueue([slot, done, enqueueTime] {
+                *slot = nowNs() - enqueueTime;
+                done->fetch_add(1, std::memory_order_release);
+            });
+        }
+    });
+    waitForCount(numDone, totalOps);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    BenchmarkResult res{"enqueue", params.executorName_, params.threads_, totalOps,
+            duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+BenchmarkResult benchBulkEnqueue(const RunParams& params) {
+    constexpr long batchSize = 64;
+    long opsPerProducer = params.ops_ / params.threads_ / batchSize * batchSize;
+    long totalOps = opsPerProducer * params.threads_;
+    std::vector<std::int64_t> latencies(totalOps);
+    std::atomic<long> numDone{0};
+
+    auto start = BenchClock::now();
+    runProducers(params.threads_, [&](int producerIdx) {
+        std::int64_t* slots = &latencies[producerIdx * opsPerProducer];
+        std::vector<Task> batch(batchSize);
+        for (long i = 0; i < opsPerProducer; i += batchSize) {
+            std::int64_t enqueueTime = nowNs();
+            for (long j = 0; j < batchSize; j++) {
+                std::int64_t* slot = slots + i + j;
+                std::atomic<long>* done = &numDone;
+                batch[j] = [slot, done, enqueueTime] {
+                    *slot = nowNs() - enqueueTime;
+                    done->fetch_add(1, std::memory_order_release);
+                };
+            }
+            params.executor_->enqueueBulk(batch.data(), batch.data() + batchSize);
+        }
+    });
+    waitForCount(numDone, totalOps);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    BenchmarkResult res{"bulkenqueue", params.executorName_, params.threads_, totalOps,
+            duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+BenchmarkResult benchSerializer(const RunParams& params) {
+    long opsPerProducer = params.ops_ / params.threads_;
+    long totalOps = opsPerProducer * params.threads_;
+    std::vector<std::int64_t> latencies(totalOps);
+    std::atomic<long> numDone{0};
+    // Protected by the serializer
+    long counter = 0;
+    auto serializer = std::make_shared<TaskSerializer>(params.executor_);
+
+    auto start = BenchClock::now();
+    runProducers(params.threads_, [&](int producerIdx) {
+        std::int64_t* slots = &latencies[producerIdx * opsPerProducer];
+        for (long i = 0; i < opsPerProducer; i++) {
+            std::int64_t* slot = slots + i;
+            long* cnt = &counter;
+            std::atomic<long>* done = &numDone;
+            std::int64_t enqueueTime = nowNs();
+            serializer->enqueue([slot, cnt, done, enqueueTime] {
+                *slot = nowNs() - enqueueTime;
+                ++*cnt;
+                done->fetch_add(1, std::memory_order_release);
+            });
+        }
+    });
+    waitForCount(numDone, totalOps);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    if (counter != totalOps) {
+        fprintf(stderr, "serializer: expected %ld tasks to run, got %ld\n", totalOps, counter);
+        exit(1);
+    }
+#if TASKS_INSTRUMENTATION
+    printCounters("serializer", serializer->counters());
+#endif
+
+    BenchmarkResult res{"serializer", params.executorName_, params.threads_, totalOps,
+            duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+BenchmarkResult benchSharedSerializer(const RunParams& params) {
+    // Spinning is cheap to set up, and makes the parallelism of the reads visible
+    constexpr std::int64_t workNs = 1000;
+    long opsPerProducer = params.ops_ / params.threads_;
+    long totalOps = opsPerProducer * params.threads_;
+    std::vector<std::int64_t> latencies(totalOps);
+    std::atomic<long> numDone{0};
+    // Check that the writes have exclusive access
+    std::atomic<int> numReading{0};
+    std::atomic<int> numWriting{0};
+    std::atomic<long> numViolations{0};
+    auto serializer = std::make_shared<SharedTaskSerializer>(params.executor_);
+
+    auto spin = [] {
+        std::int64_t end = nowNs() + workNs;
+        while (nowNs() < end) {
+        }
+    };
+    auto start = BenchClock::now();
+    runProducers(params.threads_, [&](int producerIdx) {
+        std::int64_t* slots = &latencies[producerIdx * opsPerProducer];
+        for (long i = 0; i < opsPerProducer; i++) {
+            std::int64_t* slot = slots + i;
+            std::int64_t enqueueTime = nowNs();
+            if (i % 10 == 0) {
+                serializer->enqueueWrite([&, slot, enqueueTime] {
+                    *slot = nowNs() - enqueueTime;
+                    if (numWriting.fetch_add(1) != 0 || numReading.load() != 0)
+                        numViolations++;
+                    spin();
+                    numWriting.fetch_sub(1);
+                    numDone.fetch_add(1, std::memory_order_release);
+                });
+            } else {
+                serializer->enqueueRead([&, slot, enqueueTime] {
+                    *slot = nowNs() - enqueueTime;
+                    numReading.fetch_add(1);
+                    if (numWriting.load() != 0)
+                        numViolations++;
+                    spin();
+                    numReading.fetch_sub(1);
+                    numDone.fetch_add(1, std::memory_order_release);
+                });
+            }
+        }
+    });
+    waitForCount(numDone, totalOps);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    if (numViolations.load() != 0) {
+        fprintf(stderr, "sharedserializer: %ld tasks ran in parallel with a write\n",
+                numViolations.load());
+        exit(1);
+    }
+
+    BenchmarkResult res{"sharedserializer", params.executorName_, params.threads_, totalOps,
+            duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+//! Runs producers against a bounded serializer with the suspend policy. If 'checkOrder' is set,
+//! the producers enqueue one at a time, so that we know the order in which they were suspended;
+//! otherwise, they race with each other, and with the tasks that complete.
+BenchmarkResult runBoundedSerializer(
+        const char* name, const RunParams& params, bool checkOrder) {
+    // Small enough for the producers to fill it often
+    constexpr std::size_t capacity = 16;
+    // Always have concurrent producers, even with a single worker thread
+    int numProducers = checkOrder ? params.threads_ : std::max(params.threads_, 2);
+    long opsPerProducer = params.ops_ / numProducers;
+    long totalOps = opsPerProducer * numProducers;
+    std::vector<std::int64_t> latencies(totalOps);
+    std::atomic<long> numDone{0};
+    std::atomic<long> numViolations{0};
+    // The tasks, in the order they were executed; protected by the serializer
+    std::vector<long> executionOrder(totalOps);
+    long numExecuted = 0;
+    // The tasks that suspended their producers, in the order they were suspended. If checking the
+    // order, the producers enqueue under the mutex, so this is also the order in which the
+    // serializer suspended them.
+    std::mutex suspendMutex;
+    std::vector<long> suspendOrder;
+    suspendOrder.reserve(totalOps);
+    TaskSerializerOptions options;
+    options.capacity = capacity;
+    options.overflowPolicy = OverflowPolicy::suspend;
+    auto serializer = std::make_shared<TaskSerializer>(params.executor_, options);
+
+    auto start = BenchClock::now();
+    runProducers(numProducers, [&](int producerIdx) {
+        for (long i = 0; i < opsPerProducer; i++) {
+            long taskIdx = producerIdx * opsPerProducer + i;
+            std::int64_t* slot = &latencies[taskIdx];
+            std::int64_t enqueueTime = nowNs();
+            std::atomic<bool> resumed{false};
+            EnqueueStatus status;
+            {
+                std::unique_lock<std::mutex> lock(suspendMutex, std::defer_lock);
+                if (checkOrder)
+                    lock.lock();
+                status = serializer->tryEnqueue(
+                        [&, slot, enqueueTime, taskIdx] {
+                            *slot = nowNs() - enqueueTime;
+                            if (serializer->depth() > capacity)
+                                numViolations++;
+                            if (numExecuted < totalOps)
+                                executionOrder[numExecuted] = taskIdx;
+                            numExecuted++;
+                            numDone.fetch_add(1, std::memory_order_release);
+                        },
+                        TaskPriority::normal,
+                        [&resumed] { resumed.store(true, std::memory_order_release); });
+                if (checkOrder && status == EnqueueStatus::suspended)
+                    suspendOrder.push_back(taskIdx);
+            }
+            if (serializer->depth() > capacity)
+                numViolations++;
+            // Don't produce anything else until our task enters the serializer
+            if (status == EnqueueStatus::suspended) {
+                while (!resumed.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+            } else if (status != EnqueueStatus::enqueued)
+                numViolations++;
+        }
+    });
+    waitForCount(numDone, totalOps);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    if (numViolations.load() != 0) {
+        fprintf(stderr, "%s: the serializer was found %ld times over its capacity\n", name,
+                numViolations.load());
+        exit(1);
+    }
+    // Check that each task was executed exactly once, and find where
+    std::vector<long> positions(totalOps, -1);
+    for (long pos = 0; pos < std::min(numExecuted, totalOps); pos++) {
+        long& taskPos = positions[executionOrder[pos]];
+        if (taskPos >= 0)
+            numViolations++;
+        taskPos = pos;
+    }
+    if (numExecuted != totalOps || numViolations.load() != 0) {
+        fprintf(stderr, "%s: expected %ld tasks to run once, got %ld runs\n", name, totalOps,
+                numExecuted);
+        exit(1);
+    }
+    // The suspended tasks must enter the serializer, and thus run, in the order of suspension
+    for (std::size_t i = 1; i < suspendOrder.size(); i++)
+        if (positions[suspendOrder[i]] < positions[suspendOrder[i - 1]])
+            numViolations++;
+    if (numViolations.load() != 0) {
+        fprintf(stderr, "%s: %ld suspended tasks ran out of order\n", name,
+                numViolations.load());
+        exit(1);
+    }
+
+    BenchmarkResult res{name, params.executorName_, params.threads_, totalOps, duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+BenchmarkResult benchBoundedSerializer(const RunParams& params) {
+    return runBoundedSerializer("boundedserializer", params, false);
+}
+
+BenchmarkResult benchBoundedFifo(const RunParams& params) {
+    return runBoundedSerializer("boundedfifo", params, true);
+}
+
+//! Two serializers sending a message back and forth
+template <typename Serializer>
+struct PingPong {
+    Serializer ping_;
+    Serializer pong_;
+    Serializer* serializers_[2]{&ping_, &pong_};
+    std::vector<std::int64_t> latencies_;
+    std::atomic<long> numDone_{0};
+
+    //! Creates the serializers on top of the given executor (a TaskExecutorPtr for TaskSerializer,
+    //! a reference to the concrete executor for StaticSerializer)
+    template <typename Executor>
+    PingPong(Executor&& executor, long numHops)
+        : ping_(executor)
+        , pong_(executor)
+        , latencies_(numHops) {}
+
+    void send(long hop, int target) {
+        std::int64_t sendTime = nowNs();
+        serializers_[target]->enqueue([this, hop, target, sendTime] {
+            latencies_[hop] = nowNs() - sendTime;
+            if (hop + 1 < long(latencies_.size()))
+                send(hop + 1, 1 - target);
+            else
+                numDone_.store(1, std::memory_order_release);
+        });
+    }
+};
+
+template <typename Serializer, typename Executor>
+BenchmarkResult runPingPong(const char* name, const RunParams& params, Executor&& executor) {
+    // Hops are sequential; use fewer of them, to keep the running time comparable
+    long numHops = std::max(params.ops_ / 10, 1L);
+    std::unique_ptr<PingPong<Serializer>> pingPong{new PingPong<Serializer>(executor, numHops)};
+
+    auto start = BenchClock::now();
+    pingPong->send(0, 0);
+    waitForCount(pingPong->numDone_, 1);
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    BenchmarkResult res{name, params.executorName_, params.threads_, numHops, duration.count()};
+    computePercentiles(pingPong->latencies_, res);
+    return res;
+}
+
+BenchmarkResult benchPingPong(const RunParams& params) {
+    return runPingPong<TaskSerializer>("pingpong", params, params.executor_);
+}
+
+BenchmarkResult benchStaticPingPong(const RunParams& params) {
+    if (auto tbbExecutor = std::dynamic_pointer_cast<GlobalTaskExecutor>(params.executor_))
+        return runPingPong<StaticSerializer<GlobalTaskExecutor>>(
+                "staticpingpong", params, *tbbExecutor);
+    auto wsExecutor = std::dynamic_pointer_cast<WorkStealingExecutor>(params.executor_);
+    return runPingPong<StaticSerializer<WorkStealingExecutor>>(
+            "staticpingpong", params, *wsExecutor);
+}
+
+//! Tree of tasks: each inner node spawns 'fanout' children and completes when all of them complete
+struct FanOutTree {
+    //! Join point for the children of an inner node
+    struct Join {
+        std::atomic<int> pending_;
+        Join* parent_;
+    };
+
+    TaskExecutor& executor_;
+    int fanout_;
+    std::atomic<bool> done_{false};
+
+    FanOutTree(TaskExecutor& executor, int fanout)
+        : executor_(executor)
+        , fanout_(fanout) {}
+
+    //! Runs a node with the given depth; depth zero means a leaf
+    void run(int depth, Join* parent) {
+        if (depth == 0) {
+            complete(parent);
+            return;
+        }
+        auto join = new Join{{fanout_}, parent};
+        for (int i = 0; i < fanout_; i++)
+            executor_.enqueue([this, depth, join] { run(depth - 1, join); });
+    }
+
+    //! Called when a child completed; propagates the completion up the tree
+    void complete(Join* join) {
+        while (join) {
+            if (join->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            Join* parent = join->parent_;
+            delete join;
+            join = parent;
+        }
+        done_.store(true, std::memory_order_release);
+    }
+
+    //! Returns the number of nodes in a tree of the given depth
+    long numNodes(int depth) const {
+        long res = 1;
+        long levelSize = 1;
+        for (int i = 0; i < depth; i++) {
+            levelSize *= fanout_;
+            res += levelSize;
+        }
+        return res;
+    }
+};
+
+BenchmarkResult benchFanOut(const RunParams& params) {
+    constexpr int fanout = 4;
+    constexpr int depth = 5;
+    FanOutTree tree(*params.executor_, fanout);
+    long numTrees = std::max(params.ops_ / tree.numNodes(depth), 1L);
+    std::vector<std::int64_t> latencies(numTrees);
+
+    auto start = BenchClock::now();
+    for (long i = 0; i < numTrees; i++) {
+        std::int64_t treeStart = nowNs();
+        tree.done_.store(false, std::memory_order_relaxed);
+        tree.run(depth, nullptr);
+        while (!tree.done_.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        latencies[i] = nowNs() - treeStart;
+    }
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    BenchmarkResult res{"fanout", params.executorName_, params.threads_,
+            numTrees * tree.numNodes(depth), duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+//! A task that keeps retrying until the tasks enqueued before it complete. The retries must not
+//! starve the older tasks, even if they are all on the same worker.
+struct RetryLoop {
+    //! Beyond this many retries in one round, we consider the older tasks starved
+    static constexpr long maxRetries = 1000000;
+
+    TaskExecutor& executor_;
+    int numHolders_;
+    std::atomic<int> numHoldersDone_{0};
+    //! Only accessed by the retry task, which has a single instance in flight
+    long numRetries_{0};
+    bool starved_{false};
+    std::atomic<bool> done_{false};
+
+    RetryLoop(TaskExecutor& executor, int numHolders)
+        : executor_(executor)
+        , numHolders_(numHolders) {}
+
+    //! Starts a round: enqueues the holder tasks, then the retry loop, both from a worker thread
+    void start() {
+        numHoldersDone_.store(0, std::memory_order_relaxed);
+        numRetries_ = 0;
+        done_.store(false, std::memory_order_relaxed);
+        executor_.enqueue([this] {
+            for (int i = 0; i < numHolders_; i++)
+                executor_.enqueue(
+                        [this] { numHoldersDone_.fetch_add(1, std::memory_order_release); });
+            retry();
+        });
+    }
+
+    //! Checks if the holders are done; if not, tries again later
+    void retry() {
+        if (numHoldersDone_.load(std::memory_order_acquire) == numHolders_) {
+            done_.store(true, std::memory_order_release);
+            return;
+        }
+        if (++numRetries_ > maxRetries) {
+            starved_ = true;
+            done_.store(true, std::memory_order_release);
+            return;
+        }
+        executor_.enqueue([this] { retry(); });
+    }
+};
+
+BenchmarkResult benchRetryLoop(const RunParams& params) {
+    constexpr int numHolders = 16;
+    RetryLoop loop(*params.executor_, numHolders);
+    long numRounds = std::max(params.ops_ / 100, 1L);
+    std::vector<std::int64_t> latencies(numRounds);
+    long totalOps = 0;
+
+    auto start = BenchClock::now();
+    for (long i = 0; i < numRounds; i++) {
+        std::int64_t roundStart = nowNs();
+        loop.start();
+        while (!loop.done_.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        latencies[i] = nowNs() - roundStart;
+        if (loop.starved_) {
+            fprintf(stderr, "retryloop: the older tasks were starved for %ld retries\n",
+                    RetryLoop::maxRetries);
+            exit(1);
+        }
+        totalOps += numHolders + loop.numRetries_;
+    }
+    std::chrono::duration<double> duration = BenchClock::now() - start;
+
+    BenchmarkResult res{"retryloop", params.executorName_, params.threads_, totalOps,
+            duration.count()};
+    computePercentiles(latencies, res);
+    return res;
+}
+
+using BenchmarkFun = BenchmarkResult (*)(const RunParams&);
+
+struct BenchmarkDesc {
+    const char* name_;
+    BenchmarkFun fun_;
+};
+
+const BenchmarkDesc allBenchmarks[] = {
+        {"enqueue", &benchEnqueue},
+        {"bulkenqueue", &benchBulkEnqueue},
+        {"serializer", &benchSerializer},
+        {"sharedserializer", &benchSharedSerializer},
+        {"boundedserializer", &benchBoundedSerializer},
+        {"boundedfifo", &benchBoundedFifo},
+        {"pingpong", &benchPingPong},
+        {"staticpingpong", &benchStaticPingPong},
+        {"fanout", &benchFanOut},
+        {"retryloop", &benchRetryLoop},
+};
+
+TaskExecutorPtr makeExecutor(const std::string& name, int numThreads) {
+    if (name == "tbb")
+        return std::make_shared<GlobalTaskExecutor>(numThreads);
+    if (name == "ws")
+        return std::make_shared<WorkStealingExecutor>(numThreads);
+    fprintf(stderr, "Unknown executor: %s\n", name.c_str());
+    exit(1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool json = false;
+    std::vector<std::string> executors{"tbb", "ws"};
+    std::vector<int> threadCounts{1, 2, 4, 8};
+    std::vector<std::string> benchmarks;
+    long ops = 200000;
+
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (matchArg(argv[i], "--format=", value))
+            json = value == "json";
+        else if (matchArg(argv[i], "--executors=", value))
+            executors = parseNameList(value);
+        else if (matchArg(argv[i], "--threads=", value))
+            threadCounts = parseIntList(value);
+        else if (matchArg(argv[i], "--benchmarks=", value))
+            benchmarks = parseNameList(value);
+        else if (matchArg(argv[i], "--ops=", value))
+            ops = std::atol(value.c_str());
+        else {
+            fprintf(stderr,
+                    "Usage: %s [--format=csv|json] [--executors=tbb,ws] [--threads=1,2,4,8] "
+                    "[--benchmarks=enqueue,bulkenqueue,serializer,sharedserializer,"
+                    "boundedserializer,boundedfifo,pingpong,staticpingpong,fanout,retryloop] "
+                    "[--ops=N]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    ResultPrinter printer(json);
+    printer.printHeader();
+    for (const auto& executorName : executors) {
+        for (int numThreads : threadCounts) {
+            if (numThreads < 1)
+                continue;
+            // Allow TBB to create as many workers as requested, even above the number of cores
+            tbb::global_control threadsLimit(
+                    tbb::global_control::max_allowed_parallelism, numThreads + 1);
+            RunParams params{executorName, makeExecutor(executorName, numThreads), numThreads, ops};
+            for (const auto& bench : allBenchmarks) {
+                if (!benchmarks.empty() &&
+                        std::find(benchmarks.begin(), benchmarks.end(), bench.name_) ==
+                                benchmarks.end())
+                    continue;
+                printer.print(bench.fun_(params));
+            }
+        }
+    }
+    return 0;
+}
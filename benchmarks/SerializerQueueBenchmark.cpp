@@ -0,0 +1,110 @@
+// Compares the standby queue used by TaskSerializer (intrusive MPSC queue, with the draining state
+// kept in the queue tail), against the previous implementation (tbb::concurrent_queue plus a
+// separate atomic counter). Multiple producers push tasks, while a single consumer executes them.
+// Prints the results in CSV format.
+
+#include "tasks/MpscQueue.hpp"
+#include "tasks/Task.hpp"
+
+#include "tbb/concurrent_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//! The previous standby queue of TaskSerializer: MPMC queue + counter of the tasks in the queue
+struct ConcurrentQueueWithCounter {
+    tbb::concurrent_queue<Task> tasks_;
+    std::atomic<int> count_{0};
+
+    void push(Task t) {
+        tasks_.emplace(std::move(t));
+        ++count_;
+    }
+    bool tryConsumeOne() {
+        Task t;
+        if (!tasks_.try_pop(t))
+            return false;
+        t();
+        --count_;
+        return true;
+    }
+};
+
+//! The current standby queue of TaskSerializer: intrusive MPSC queue
+struct IntrusiveMpscQueue {
+    struct TaskNode : MpscNode {
+        Task task_;
+
+        TaskNode(Task t)
+            : task_(std::move(t)) {}
+    };
+    MpscQueue tasks_;
+
+    void push(Task t) { tasks_.push(new TaskNode(std::move(t))); }
+    bool tryConsumeOne() {
+        auto node = static_cast<TaskNode*>(tasks_.pop());
+        if (!node)
+            return false;
+        node->task_();
+        delete node;
+        return true;
+    }
+};
+
+//! Runs 'numProducers' threads that push 'numTasksPerProducer' tasks each; the calling thread
+//! consumes all the tasks. Returns the duration, in seconds, until all the tasks are executed.
+template <typename Queue>
+double runBenchmark(int numProducers, int numTasksPerProducer) {
+    Queue queue;
+    long executed = 0;
+    const long total = long(numProducers) * numTasksPerProducer;
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> producers;
+    producers.reserve(numProducers);
+    for (int i = 0; i < numProducers; i++)
+        producers.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (int j = 0; j < numTasksPerProducer; j++)
+                queue.push([&executed] { executed++; });
+        });
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    while (executed < total) {
+        if (!queue.tryConsumeOne())
+            std::this_thread::yield();
+    }
+    auto end = Clock::now();
+
+    for (auto& t : producers)
+        t.join();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template <typename Queue>
+void report(const char* queueName, int numProducers, int numTasksPerProducer) {
+    double seconds = runBenchmark<Queue>(numProducers, numTasksPerProducer);
+    long total = long(numProducers) * numTasksPerProducer;
+    printf("%s,%d,%ld,%.6f,%.0f\n", queueName, numProducers, total, seconds, total / seconds);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    int numTasksPerProducer = argc > 1 ? atoi(argv[1]) : 100000;
+
+    printf("queue,producers,tasks,seconds,tasks_per_sec\n");
+    for (int numProducers : {1, 2, 4, 8, 16, 32, 64}) {
+        report<ConcurrentQueueWithCounter>(
+                "concurrent_queue+counter", numProducers, numTasksPerProducer);
+        report<IntrusiveMpscQueue>("intrusive_mpsc", numProducers, numTasksPerProducer);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "Protocol.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief      Waiter that hands the forks to the philosophers without serializing the requests.
+ *
+ * The forks are kept in a packed bitmap of atomic words; a set bit means that the fork is in use.
+ * When both forks of a philosopher are in the same word, they are acquired together, with a single
+ * CAS on that word. When they are in different words (the last philosopher of a word, and the last
+ * philosopher at the table), the forks are acquired one by one, in the order of the words; if the
+ * second fork cannot be acquired, the first one is released.
+ *
+ * There is no central point of synchronization; philosophers only contend with their neighbors.
+ */
+class AtomicWaiter {
+public:
+    AtomicWaiter(int numSeats, TaskExecutorPtr executor)
+        : numSeats_(numSeats)
+        , executor_(std::move(executor)) {
+        int numWords = (numSeats + bitsPerWord - 1) / bitsPerWord;
+        forksInUse_.reset(new std::atomic<std::uint64_t>[numWords]);
+        for (int i = 0; i < numWords; i++)
+            forksInUse_[i].store(0, std::memory_order_relaxed);
+    }
+
+    void requestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
+        // Nothing is serialized here, so a failed philosopher could retry right away, in a tight
+        // loop, ahead of the neighbor that holds the forks; use a low priority to back off
+        if (tryAcquireForks(philosopherIdx))
+            executor_->enqueue(std::move(onSuccess));
+        else
+            executor_->enqueue(std::move(onFailure), TaskPriority::low);
+    }
+
+    void returnForks(int philosopherIdx) {
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats_;
+        if (wordOf(idxLeft) == wordOf(idxRight))
+            release(wordOf(idxLeft), maskOf(idxLeft) | maskOf(idxRight));
+        else {
+            release(wordOf(idxLeft), maskOf(idxLeft));
+            release(wordOf(idxRight), maskOf(idxRight));
+        }
+    }
+
+private:
+    static constexpr int bitsPerWord = 64;
+
+    static int wordOf(int forkIdx) { return forkIdx / bitsPerWord; }
+    static std::uint64_t maskOf(int forkIdx) {
+        return std::uint64_t(1) << (forkIdx % bitsPerWord);
+    }
+
+    //! Tries to mark the two forks of the philosopher as being in use
+    bool tryAcquireForks(int philosopherIdx) {
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats_;
+        if (wordOf(idxLeft) == wordOf(idxRight))
+            return tryAcquire(wordOf(idxLeft), maskOf(idxLeft) | maskOf(idxRight));
+
+        // The forks are in different words; acquire them in the order of the words
+        int first = wordOf(idxLeft) < wordOf(idxRight) ? idxLeft : idxRight;
+        int second = first == idxLeft ? idxRight : idxLeft;
+        if (!tryAcquire(wordOf(first), maskOf(first)))
+            return false;
+        if (!tryAcquire(wordOf(second), maskOf(second))) {
+            release(wordOf(first), maskOf(first));
+            return false;
+        }
+        return true;
+    }
+
+    //! Tries to set all the bits of 'mask' in the given word; fails if any of them is already set
+    bool tryAcquire(int wordIdx, std::uint64_t mask) {
+        auto& word = forksInUse_[wordIdx];
+        std::uint64_t cur = word.load(std::memory_order_relaxed);
+        do {
+            if (cur & mask)
+                return false;
+        } while (!word.compare_exchange_weak(
+                cur, cur | mask, std::memory_order_acquire, std::memory_order_relaxed));
+        return true;
+    }
+
+    //! Clears the bits of 'mask' in the given word
+    void release(int wordIdx, std::uint64_t mask) {
+        assert((forksInUse_[wordIdx].load(std::memory_order_relaxed) & mask) == mask);
+        forksInUse_[wordIdx].fetch_and(~mask, std::memory_order_release);
+    }
+
+    //! The number of seats (and forks) at the table
+    int numSeats_;
+    //! The forks on the table, one bit per fork; the bit is set while the fork is in use
+    std::unique_ptr<std::atomic<std::uint64_t>[]> forksInUse_;
+    //! The executor used to schedule tasks
+    TaskExecutorPtr executor_;
+};
+
+class AtomicWaiterPhilosopherProtocol : public PhilosopherProtocol {
+public:
+    AtomicWaiterPhilosopherProtocol(
+            int philosopherIdx, std::shared_ptr<AtomicWaiter> waiter, TaskExecutorPtr executor)
+        : philosopherIdx_(philosopherIdx)
+        , waiter_(waiter)
+        , executor_(executor) {}
+
+    void startDining(Task eatTask, Task eatFailureTask, Task thinkTask, Task leaveTask) final {
+        eatTask_ = std::move(eatTask);
+        eatFailureTask_ = std::move(eatFailureTask);
+        thinkTask_ = std::move(thinkTask);
+        leaveTask_ = std::move(leaveTask);
+        executor_->enqueue([this] { thinkTask_(); }); // Start by thinking
+    }
+    void onEatingDone(bool leavingTable) final {
+        // Return the forks
+        waiter_->returnForks(philosopherIdx_);
+        // Next action for the philosopher
+        if (!leavingTable)
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
+        else
+            executor_->enqueue([this] { leaveTask_(); });
+    }
+    void onThinkingDone() final {
+        waiter_->requestForks(
+                philosopherIdx_, [this] { eatTask_(); }, [this] { eatFailureTask_(); });
+    }
+
+private:
+    //! The index of the philosopher
+    int philosopherIdx_;
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<AtomicWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+    //! The implementation of the actions that the philosopher does
+    Task eatTask_, eatFailureTask_, thinkTask_, leaveTask_;
+};
+
+class AtomicWaiterTableProtocol : public TableProtocol {
+public:
+    AtomicWaiterTableProtocol(int numSeats, TaskExecutorPtr executor)
+        : waiter_(std::make_shared<AtomicWaiter>(numSeats, executor))
+        , executor_(executor) {}
+
+    std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) final {
+        return std::unique_ptr<PhilosopherProtocol>(
+                new AtomicWaiterPhilosopherProtocol(idx, waiter_, executor_));
+    }
+
+private:
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<AtomicWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Protocol.hpp"
+#include "tasks/Coroutine.hpp"
+#include "tasks/TaskSerializer.hpp"
+
+#if TASKS_HAS_COROUTINES
+
+#include <cassert>
+#include <vector>
+
+/**
+ * @brief      Waiter that hands the forks to the philosophers, written with coroutines.
+ *
+ * Same policy as the Waiter, but the protocol logic is straight-line code: the coroutines enter
+ * the critical section by awaiting the serializer, and leave it by awaiting the executor.
+ */
+class CoroutineWaiter {
+public:
+    CoroutineWaiter(int numSeats, TaskExecutorPtr executor)
+        : executor_(executor)
+        , serializer_(executor, waiterSerializerOptions()) {
+        // Arrange the forks on the table; they are not in use at this time
+        forksInUse_.resize(numSeats, false);
+    }
+
+    //! Requests the forks for the given philosopher; returns true if the forks were acquired.
+    //! The caller is resumed on the executor.
+    CoTask<bool> requestForks(int philosopherIdx) {
+        co_await serializer_;
+        // Critical section
+        int numSeats = forksInUse_.size();
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats;
+        bool canEat = !forksInUse_[idxLeft] && !forksInUse_[idxRight];
+        if (canEat) {
+            forksInUse_[idxLeft] = true;
+            forksInUse_[idxRight] = true;
+        }
+        co_await *executor_;
+        // Outside of the critical section; the caller will continue right here
+        co_return canEat;
+    }
+
+    //! Returns the forks of the given philosopher
+    CoTask<> returnForks(int philosopherIdx) {
+        // Returning the forks has priority; others may wait for them
+        co_await schedule(serializer_, TaskPriority::high);
+        int numSeats = forksInUse_.size();
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats;
+        assert(forksInUse_[idxLeft]);
+        assert(forksInUse_[idxRight]);
+        forksInUse_[idxLeft] = false;
+        forksInUse_[idxRight] = false;
+    }
+
+private:
+    //! The forks on the table, with flag indicating whether they are in use or not
+    std::vector<bool> forksInUse_;
+    //! The executor used to schedule tasks
+    TaskExecutorPtr executor_;
+    //! Serializer object used to ensure serialized accessed to the waiter
+    TaskSerializer serializer_;
+};
+
+class CoroutineWaiterPhilosopherProtocol : public PhilosopherProtocol {
+public:
+    CoroutineWaiterPhilosopherProtocol(
+            int philosopherIdx, std::shared_ptr<CoroutineWaiter> waiter, TaskExecutorPtr executor)
+        : philosopherIdx_(philosopherIdx)
+        , waiter_(waiter)
+        , executor_(executor) {}
+
+    void startDining(Task eatTask, Task eatFailureTask, Task thinkTask, Task leaveTask) final {
+        eatTask_ = std::move(eatTask);
+        eatFailureTask_ = std::move(eatFailureTask);
+        thinkTask_ = std::move(thinkTask);
+        leaveTask_ = std::move(leaveTask);
+        executor_->enqueue([this] { thinkTask_(); }); // Start by thinking
+    }
+    void onEatingDone(bool leavingTable) final {
+        // Return the forks
+        waiter_->returnForks(philosopherIdx_).detach();
+        // Next action for the philosopher
+        if (!leavingTable)
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
+        else
+            executor_->enqueue([this] { leaveTask_(); });
+    }
+    void onThinkingDone() final { tryEat().detach(); }
+
+private:
+    CoTask<> tryEat() {
+        // The waiter resumes us directly when done; no additional enqueue needed.
+        // Note: keep the result in a local; GCC 12 miscompiles a co_await used directly as the
+        // condition of the if statement, and the philosopher is never resumed.
+        bool acquired = co_await waiter_->requestForks(philosopherIdx_);
+        if (acquired)
+            eatTask_();
+        else
+            eatFailureTask_();
+    }
+
+    //! The index of the philosopher
+    int philosopherIdx_;
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<CoroutineWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+    //! The implementation of the actions that the philosopher does
+    Task eatTask_, eatFailureTask_, thinkTask_, leaveTask_;
+};
+
+class CoroutineWaiterTableProtocol : public TableProtocol {
+public:
+    CoroutineWaiterTableProtocol(int numSeats, TaskExecutorPtr executor)
+        : waiter_(std::make_shared<CoroutineWaiter>(numSeats, executor))
+        , executor_(executor) {}
+
+    std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) final {
+        return std::unique_ptr<PhilosopherProtocol>(
+                new CoroutineWaiterPhilosopherProtocol(idx, waiter_, executor_));
+    }
+
+private:
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<CoroutineWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+};
+
+#endif
@@ -2,65 +2,285 @@
 #include "Utils.hpp"
 #include "Protocol.hpp"
 #include "Philosopher.hpp"
+#include "EventTrace.hpp"
 #include "IncorrectProtocol.hpp"
 #include "WaiterProtocol.hpp"
 #include "WaiterFairProtocol.hpp"
+#include "AtomicWaiterProtocol.hpp"
+#include "ShardedWaiterProtocol.hpp"
 #include "ForkLevelProtocol.hpp"
+#include "CoroutineWaiterProtocol.hpp"
 #include "tasks/GlobalTaskExecutor.hpp"
+#include "tasks/WorkStealingExecutor.hpp"
+#include "tasks/NumaExecutor.hpp"
+#include "utils/CommandLine.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <string>
 #include <vector>
-#include "tbb/task_scheduler_init.h"
+#include "tbb/global_control.h"
 
 const char* philosopherNames[] = {"Socrates", "Plato", "Aristotle", "Descartes", "Spinoza", "Kant",
         "Schopenhauer", "Nietzsche", "Wittgenstein", "Heidegger", "Sartre"};
-static constexpr int numPhilosophers = 3;
-// static constexpr int numPhilosophers = sizeof(philosopherNames) / sizeof(philosopherNames[0]);
+static constexpr int numPhilosopherNames = sizeof(philosopherNames) / sizeof(philosopherNames[0]);
+
+//! The settings of the dinner; by default, a small dinner that shows the activities of the
+//! philosophers. With a large number of philosophers, this acts as a load generator.
+struct DinnerOptions {
+    //! The number of philosophers at the table
+    int numPhilosophers_{3};
+    //! The number of meals each philosopher needs to eat
+    int numMeals_{3};
+    //! The number of worker threads; zero means one per hardware thread
+    int numThreads_{0};
+    //! How the philosophers eat and think
+    WorkMode workMode_{WorkMode::timer};
+    //! The protocol followed by the philosophers: waiter, waiterpark, waiterfair, atomicwaiter,
+    //! shardedwaiter, forklevel, forkordered (or coroutine)
+    std::string protocol_{"forklevel"};
+    //! The number of shards of the table, for the sharded waiter protocol
+    int numShards_{8};
+    //! The executor used: tbb, ws (work-stealing) or numa
+    std::string executor_{"tbb"};
+    //! If not zero, stop the dinner after this many seconds, even if not all meals were eaten
+    int maxSeconds_{0};
+    //! If not empty, the activities of the philosophers are traced into this file
+    std::string tracePath_;
+    //! The maximum number of trace events kept for each thread
+    long traceRecords_{1L << 20};
+};
+
+//! Prints the statistics of the dinner: throughput, eat failures and starvation
+void printDinnerStats(
+        const std::vector<std::unique_ptr<Philosopher>>& philosophers, double durationSec) {
+    long totalMeals = 0;
+    long totalFailures = 0;
+    std::vector<int> maxConsecutiveFailures;
+    std::vector<std::int64_t> maxHungryNs;
+    std::int64_t totalHungryNs = 0;
+    std::int64_t totalVirtualUs = 0;
+    maxConsecutiveFailures.reserve(philosophers.size());
+    maxHungryNs.reserve(philosophers.size());
+    for (const auto& ph : philosophers) {
+        const PhilosopherStats& stats = ph->stats();
+        totalMeals += stats.meals_;
+        totalFailures += stats.eatFailures_;
+        totalHungryNs += stats.totalHungryNs_;
+        totalVirtualUs += stats.virtualTime_;
+        maxConsecutiveFailures.push_back(stats.maxConsecutiveFailures_);
+        maxHungryNs.push_back(stats.maxHungryNs_);
+    }
+    std::sort(maxConsecutiveFailures.begin(), maxConsecutiveFailures.end());
+    std::sort(maxHungryNs.begin(), maxHungryNs.end());
+    auto percentile = [](const auto& values, double p) {
+        return values[std::min(std::size_t(p * values.size()), values.size() - 1)];
+    };
+
+    printf("\n");
+    printf("philosophers:            %d\n", int(philosophers.size()));
+    printf("duration:                %.3f s\n", durationSec);
+    printf("meals:                   %ld\n", totalMeals);
+    printf("meals/sec:               %.0f\n", totalMeals / durationSec);
+    printf("eat failures:            %ld\n", totalFailures);
+    printf("eat failure ratio:       %.4f\n",
+            double(totalFailures) / std::max(totalMeals + totalFailures, 1L));
+    printf("avg wait for a meal:     %.3f ms\n", totalHungryNs / 1e6 / std::max(totalMeals, 1L));
+    printf("max wait for a meal:     p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            percentile(maxHungryNs, 0.5) / 1e6, percentile(maxHungryNs, 0.99) / 1e6,
+            maxHungryNs.back() / 1e6);
+    printf("max failures in a row:   p50 %d, p99 %d, max %d\n",
+            percentile(maxConsecutiveFailures, 0.5), percentile(maxConsecutiveFailures, 0.99),
+            maxConsecutiveFailures.back());
+    // Only with --work=virtual; tells how much work the dinner would have done for real
+    if (totalVirtualUs > 0)
+        printf("virtual work:            %.3f s (%.1fx the duration)\n", totalVirtualUs / 1e6,
+                totalVirtualUs / 1e6 / durationSec);
+}
+
+void organizeDinner(
+        TableProtocol& tableProtocol, TaskExecutorPtr executor, const DinnerOptions& options) {
+    int numPhilosophers = options.numPhilosophers_;
+    std::atomic<int> numDining{numPhilosophers};
+    std::atomic<bool> stopDinner{false};
+    PhilosopherOptions philosopherOptions;
+    philosopherOptions.workMode_ = options.workMode_;
+    philosopherOptions.timer_ = std::make_shared<TimerExecutor>(executor);
+    philosopherOptions.numDining_ = &numDining;
+    philosopherOptions.stopDinner_ = &stopDinner;
+
+    // Trace the activities if we show them at the end, or if asked to
+    bool showActivities = options.workMode_ == WorkMode::timer;
+    std::unique_ptr<EventTracer> tracer;
+    if (showActivities || !options.tracePath_.empty())
+        tracer.reset(new EventTracer(std::size_t(options.traceRecords_)));
+    philosopherOptions.tracer_ = tracer.get();
 
-void organizeDinner(TableProtocol& tableProtocol) {
     // Create all the philosophers objects
-    std::vector<Philosopher> philosophers;
+    std::vector<std::unique_ptr<Philosopher>> philosophers;
     philosophers.reserve(numPhilosophers);
     for (int i = 0; i < numPhilosophers; i++) {
-        philosophers.emplace_back(philosopherNames[i]);
+        std::string name = i < numPhilosopherNames ? philosopherNames[i]
+                                                   : "Philosopher " + std::to_string(i);
+        philosophers.emplace_back(new Philosopher(name.c_str(), philosopherOptions));
+    }
+
+    // Prepare the tasks that make the philosophers join the dinner
+    std::vector<Task> startTasks;
+    startTasks.reserve(numPhilosophers);
+    for (int i = 0; i < numPhilosophers; i++) {
+        Philosopher* philosopher = philosophers[i].get();
+        auto protocol = tableProtocol.createPhilosopherProtocol(i);
+        int numMeals = options.numMeals_;
+        startTasks.emplace_back([philosopher, protocol = std::move(protocol), numMeals]() mutable {
+            philosopher->start(std::move(protocol), numMeals);
+        });
     }
 
-    // Start the dinner. At start, each philosopher will think
-    constexpr int numMeals = 3;
-    for (int i = 0; i < numPhilosophers; i++)
-        philosophers[i].start(tableProtocol.createPhilosopherProtocol(i), numMeals);
+    // Start the dinner, with all the philosophers at once. At start, each philosopher will think
+    auto startTime = getTicksNs();
+    executor->enqueueBulk(startTasks.data(), startTasks.data() + startTasks.size());
 
-    // Wait until every philosopher leaves the dinner
+    // Wait until every philosopher leaves the dinner, or until we run out of time
     // Use poor's man synchronization
-    bool isDone = true;
-    do {
-        isDone = true;
-        wait(50);
-        for (const auto& ph : philosophers)
-            isDone = isDone && ph.isDone();
-    } while (!isDone);
+    while (numDining.load(std::memory_order_acquire) > 0) {
+        wait(1);
+        auto elapsedNs = getTicksNs() - startTime;
+        if (options.maxSeconds_ > 0 && elapsedNs > options.maxSeconds_ * 1000000000LL)
+            stopDinner.store(true, std::memory_order_relaxed);
+    }
+    double durationSec = (getTicksNs() - startTime) / 1e9;
 
     // Now print the event logs for all the philosophers
-    printf("\n");
-    for (const auto& ph : philosophers)
-        ph.eventLog().printSummary();
+    if (tracer) {
+        TraceData trace = tracer->collect();
+        if (showActivities) {
+            printf("\n");
+            printActivitySummaries(trace);
+        }
+        if (!options.tracePath_.empty()) {
+            if (writeTraceFile(options.tracePath_.c_str(), trace))
+                printf("\ntrace:                   %s (%lu events, %lu dropped)\n",
+                        options.tracePath_.c_str(), (unsigned long)trace.records_.size(),
+                        (unsigned long)trace.droppedRecords_);
+            else
+                fprintf(stderr, "Cannot write the trace file: %s\n", options.tracePath_.c_str());
+        }
+    }
+    printDinnerStats(philosophers, durationSec);
+}
+
+std::unique_ptr<TableProtocol> createTableProtocol(
+        const DinnerOptions& options, TaskExecutorPtr executor) {
+    const std::string& name = options.protocol_;
+    int numSeats = options.numPhilosophers_;
+    if (name == "incorrect")
+        return std::unique_ptr<TableProtocol>(new IncorrectTableProtocol(executor));
+    if (name == "waiter")
+        return std::unique_ptr<TableProtocol>(new WaiterTableProtocol(numSeats, executor));
+    if (name == "waiterpark")
+        return std::unique_ptr<TableProtocol>(new WaiterTableProtocol(numSeats, executor, true));
+    if (name == "waiterfair")
+        return std::unique_ptr<TableProtocol>(new WaiterFairTableProtocol(numSeats, executor));
+    if (name == "atomicwaiter")
+        return std::unique_ptr<TableProtocol>(new AtomicWaiterTableProtocol(numSeats, executor));
+    if (name == "shardedwaiter")
+        return std::unique_ptr<TableProtocol>(
+                new ShardedWaiterTableProtocol(numSeats, options.numShards_, executor));
+    if (name == "forklevel")
+        return std::unique_ptr<TableProtocol>(new ForkLevelTableProtocol(numSeats, executor));
+    if (name == "forkordered")
+        return std::unique_ptr<TableProtocol>(
+                new ForkLevelTableProtocol(numSeats, executor, true));
+#if TASKS_HAS_COROUTINES
+    if (name == "coroutine")
+        return std::unique_ptr<TableProtocol>(
+                new CoroutineWaiterTableProtocol(numSeats, executor));
+#endif
+    return nullptr;
+}
+
+TaskExecutorPtr createExecutor(const std::string& name, int numThreads) {
+    if (name == "tbb")
+        return std::make_shared<GlobalTaskExecutor>(numThreads);
+    if (name == "ws")
+        return std::make_shared<WorkStealingExecutor>(numThreads);
+    if (name == "numa")
+        return std::make_shared<NumaExecutor>();
+    return nullptr;
 }
 
-int main(int /*argc*/, char** /*argv*/) {
+bool parseOptions(int argc, char** argv, DinnerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (matchArg(argv[i], "--philosophers=", value))
+            options.numPhilosophers_ = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--meals=", value))
+            options.numMeals_ = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--threads=", value))
+            options.numThreads_ = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--protocol=", value))
+            options.protocol_ = value;
+        else if (matchArg(argv[i], "--shards=", value))
+            options.numShards_ = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--executor=", value))
+            options.executor_ = value;
+        else if (matchArg(argv[i], "--seconds=", value))
+            options.maxSeconds_ = std::atoi(value.c_str());
+        else if (matchArg(argv[i], "--trace=", value))
+            options.tracePath_ = value;
+        else if (matchArg(argv[i], "--trace-records=", value))
+            options.traceRecords_ = std::atol(value.c_str());
+        else if (matchArg(argv[i], "--work=", value)) {
+            if (value == "timer")
+                options.workMode_ = WorkMode::timer;
+            else if (value == "spin")
+                options.workMode_ = WorkMode::spin;
+            else if (value == "virtual")
+                options.workMode_ = WorkMode::virtualTime;
+            else
+                return false;
+        } else
+            return false;
+    }
+    return options.numPhilosophers_ >= 2 && options.numMeals_ >= 1 && options.numThreads_ >= 0 &&
+           options.numShards_ >= 1 && options.traceRecords_ >= 1;
+}
 
-    // Ensure we have enough worker threads
-    tbb::task_scheduler_init init(numPhilosophers + 1);
+int main(int argc, char** argv) {
+    DinnerOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr,
+                "Usage: %s [--philosophers=N] [--meals=N] [--threads=N] "
+                "[--protocol=incorrect|waiter|waiterpark|waiterfair|atomicwaiter|shardedwaiter|"
+                "forklevel|forkordered|coroutine] "
+                "[--shards=N] [--executor=tbb|ws|numa] [--work=timer|spin|virtual] "
+                "[--seconds=N] [--trace=FILE] [--trace-records=N]\n"
+                "(the coroutine protocol needs a C++20 build)\n",
+                argv[0]);
+        return 1;
+    }
+    // The philosophers don't block the worker threads while waiting, so we don't need more
+    // threads than the hardware offers
+    int numThreads = options.numThreads_ ? options.numThreads_
+                                         : int(std::max(std::thread::hardware_concurrency(), 1u));
 
-    TaskExecutorPtr globalExecutor = std::make_shared<GlobalTaskExecutor>();
+    // Ensure we have the requested worker threads (the limit also counts the main thread)
+    tbb::global_control threadsLimit(
+            tbb::global_control::max_allowed_parallelism, numThreads + 1);
 
-    IncorrectTableProtocol incorrectTableProtocol{globalExecutor};
-    WaiterTableProtocol waiterTableProtocol{numPhilosophers, globalExecutor};
-    WaiterFairTableProtocol waiterFairTableProtocol{numPhilosophers, globalExecutor};
-    ForkLevelTableProtocol forkLevelTableProtocol{numPhilosophers, globalExecutor};
+    TaskExecutorPtr globalExecutor = createExecutor(options.executor_, numThreads);
+    if (!globalExecutor) {
+        fprintf(stderr, "Unknown executor: %s\n", options.executor_.c_str());
+        return 1;
+    }
+    auto tableProtocol = createTableProtocol(options, globalExecutor);
+    if (!tableProtocol) {
+        fprintf(stderr, "Unknown protocol: %s\n", options.protocol_.c_str());
+        return 1;
+    }
 
-    // organizeDinner(incorrectTableProtocol);
-    // organizeDinner(waiterTableProtocol);
-    // organizeDinner(waiterFairTableProtocol);
-    organizeDinner(forkLevelTableProtocol);
+    organizeDinner(*tableProtocol, globalExecutor, options);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,403 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class ActivityType {
+    eat,
+    eatFailure,
+    think,
+    leave,
+};
+
+//! An event in the trace: a philosopher starts or ends an activity.
+//! The records are written to the trace files as they are in memory.
+struct TraceRecord {
+    //! The time of the event; in nanoseconds since the start of the trace, once collected
+    std::uint64_t timestamp_;
+    //! The index of the philosopher, as given by EventTracer::addPhilosopher()
+    std::uint32_t philosopherIdx_;
+    //! The index of the thread that recorded the event
+    std::uint16_t threadIdx_;
+    //! The activity (an ActivityType value)
+    std::uint8_t activity_;
+    //! 1 if the activity starts, 0 if it ends
+    std::uint8_t isStart_;
+};
+static_assert(sizeof(TraceRecord) == 16, "trace records need to be compact");
+
+//! The content of a trace, as collected from the tracer or read from a trace file
+struct TraceData {
+    //! The names of the philosophers, in the order of their indices
+    std::vector<std::string> philosopherNames_;
+    //! The recorded events; timestamps in nanoseconds since the start of the trace
+    std::vector<TraceRecord> records_;
+    //! The number of threads that recorded events
+    std::uint32_t numThreads_{0};
+    //! The number of events overwritten because the buffers were full
+    std::uint64_t droppedRecords_{0};
+};
+
+/**
+ * @brief      Records the activities of the philosophers, with a low overhead.
+ *
+ * Each thread writes into its own ring buffer, preallocated the first time the thread records an
+ * event; recording an event doesn't allocate or synchronize with other threads. When a buffer is
+ * full, the oldest events of that thread are overwritten.
+ *
+ * The timestamps are taken from the time-stamp counter, when available, and converted to
+ * nanoseconds when the trace is collected. The trace can be collected only when no thread is
+ * recording events anymore.
+ */
+class EventTracer {
+public:
+    //! Creates the tracer; each thread will keep at most 'recordsPerThread' events
+    explicit EventTracer(std::size_t recordsPerThread = std::size_t(1) << 20)
+        : id_(nextTracerId().fetch_add(1) + 1)
+        , capacity_(roundUpToPowerOf2(std::max(recordsPerThread, std::size_t(2))))
+        , startTicks_(readTicks())
+        , startNs_(steadyNs()) {}
+
+    //! Registers a philosopher, returning its index in the trace
+    int addPhilosopher(std::string name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        philosopherNames_.emplace_back(std::move(name));
+        return int(philosopherNames_.size()) - 1;
+    }
+
+    //! Records an event of the given philosopher, in the buffer of the current thread
+    void record(int philosopherIdx, ActivityType at, bool isStart) {
+        ThreadBuffer& buf = localBuffer();
+        TraceRecord& rec = buf.records_[buf.next_ & (capacity_ - 1)];
+        rec.timestamp_ = readTicks();
+        rec.philosopherIdx_ = std::uint32_t(philosopherIdx);
+        rec.activity_ = std::uint8_t(at);
+        rec.isStart_ = isStart ? 1 : 0;
+        buf.next_++;
+    }
+
+    //! Gathers the events of all the threads, in chronological order.
+    //! Must not be called while events are still being recorded.
+    TraceData collect() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TraceData res;
+        res.philosopherNames_ = philosopherNames_;
+        res.numThreads_ = std::uint32_t(buffers_.size());
+
+        // Map the ticks to nanoseconds, using the elapsed time since the start of the trace
+        std::uint64_t elapsedTicks = readTicks() - startTicks_;
+        std::uint64_t elapsedNs = steadyNs() - startNs_;
+        double nsPerTick = elapsedTicks > 0 ? double(elapsedNs) / elapsedTicks : 1.0;
+
+        std::size_t total = 0;
+        for (const auto& buf : buffers_)
+            total += std::size_t(std::min<std::uint64_t>(buf->next_, capacity_));
+        res.records_.reserve(total);
+        for (const auto& buf : buffers_) {
+            std::uint64_t count = std::min<std::uint64_t>(buf->next_, capacity_);
+            res.droppedRecords_ += buf->next_ - count;
+            for (std::uint64_t i = buf->next_ - count; i < buf->next_; i++) {
+                TraceRecord rec = buf->records_[i & (capacity_ - 1)];
+                rec.timestamp_ = std::uint64_t((rec.timestamp_ - startTicks_) * nsPerTick);
+                rec.threadIdx_ = std::uint16_t(buf->threadIdx_);
+                res.records_.push_back(rec);
+            }
+        }
+        std::stable_sort(res.records_.begin(), res.records_.end(),
+                [](const TraceRecord& lhs, const TraceRecord& rhs) {
+                    return lhs.timestamp_ < rhs.timestamp_;
+                });
+        return res;
+    }
+
+private:
+    //! The events recorded by one thread; only that thread writes into it
+    struct ThreadBuffer {
+        std::thread::id threadId_;
+        int threadIdx_;
+        std::unique_ptr<TraceRecord[]> records_;
+        //! The number of events recorded so far; the next one goes at this index (modulo capacity)
+        std::uint64_t next_{0};
+    };
+
+    //! Returns the buffer of the current thread, creating it the first time
+    ThreadBuffer& localBuffer() {
+        // Cache the buffer of the last tracer used on this thread
+        static thread_local std::uint64_t cachedTracerId = 0;
+        static thread_local ThreadBuffer* cachedBuffer = nullptr;
+        if (cachedTracerId != id_) {
+            cachedBuffer = &findOrCreateBuffer();
+            cachedTracerId = id_;
+        }
+        return *cachedBuffer;
+    }
+
+    ThreadBuffer& findOrCreateBuffer() {
+        std::thread::id threadId = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& buf : buffers_)
+            if (buf->threadId_ == threadId)
+                return *buf;
+        std::unique_ptr<ThreadBuffer> buf{new ThreadBuffer};
+        buf->threadId_ = threadId;
+        buf->threadIdx_ = int(buffers_.size());
+        // Value-initialize the records, so that the pages are touched now, and not while tracing
+        buf->records_.reset(new TraceRecord[capacity_]());
+        buffers_.emplace_back(std::move(buf));
+        return *buffers_.back();
+    }
+
+    static std::uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return steadyNs();
+#endif
+    }
+    static std::uint64_t steadyNs() {
+        using namespace std::chrono;
+        return std::uint64_t(
+                duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+    static std::size_t roundUpToPowerOf2(std::size_t n) {
+        std::size_t res = 1;
+        while (res < n)
+            res <<= 1;
+        return res;
+    }
+    static std::atomic<std::uint64_t>& nextTracerId() {
+        static std::atomic<std::uint64_t> id{0};
+        return id;
+    }
+
+    //! Unique identifier of the tracer, used to find the buffer of the thread
+    std::uint64_t id_;
+    //! The number of records in each buffer; a power of two
+    std::size_t capacity_;
+    //! The ticks and the steady clock time when the tracer was created
+    std::uint64_t startTicks_;
+    std::uint64_t startNs_;
+    //! Protects the lists below
+    mutable std::mutex mutex_;
+    //! The names of the registered philosophers
+    std::vector<std::string> philosopherNames_;
+    //! The buffers of all the threads that recorded events
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+//! Records the activities of one philosopher in the tracer. Without a tracer, nothing is recorded.
+class PhilosopherEventLog {
+public:
+    PhilosopherEventLog(EventTracer* tracer, const char* philosopherName)
+        : tracer_(tracer)
+        , philosopherIdx_(tracer ? tracer->addPhilosopher(philosopherName) : 0) {}
+
+    //! Called when a philosopher starts an activity
+    void startActivity(ActivityType at) {
+        if (tracer_)
+            tracer_->record(philosopherIdx_, at, true);
+    }
+    //! Called when a philosopher ends an activity
+    void endActivity(ActivityType at) {
+        if (tracer_)
+            tracer_->record(philosopherIdx_, at, false);
+    }
+
+private:
+    EventTracer* tracer_;
+    int philosopherIdx_;
+};
+
+namespace detail {
+//! Identifies the trace files; the last character is the version of the format
+static constexpr char traceFileMagic[8] = {'P', 'H', 'I', 'L', 'T', 'R', 'C', '1'};
+
+//! The header of the trace files; followed by the names of the philosophers (each with the
+//! length as a 32-bit integer, then the characters), then by the records.
+//! Everything is written with the byte order of the machine that recorded the trace.
+struct TraceFileHeader {
+    char magic_[8];
+    std::uint32_t numThreads_;
+    std::uint32_t numPhilosophers_;
+    std::uint64_t numRecords_;
+    std::uint64_t droppedRecords_;
+};
+
+inline char activityToChar(ActivityType at) {
+    switch (at) {
+    case ActivityType::eat:
+        return 'E';
+    case ActivityType::eatFailure:
+        return '.';
+    case ActivityType::think:
+        return 't';
+    case ActivityType::leave:
+        return 'L';
+    default:
+        return '?';
+    }
+}
+inline const char* activityToString(ActivityType at) {
+    switch (at) {
+    case ActivityType::eat:
+        return "eat";
+    case ActivityType::eatFailure:
+        return "failed to eat";
+    case ActivityType::think:
+        return "think";
+    case ActivityType::leave:
+        return "leave";
+    default:
+        return "???";
+    }
+}
+inline void printChars(char ch, int count) {
+    for (int i = 0; i < count; i++)
+        putchar(ch);
+}
+
+//! Writes the string to the JSON output, escaping it as needed
+inline void writeJsonString(FILE* out, const std::string& str) {
+    fputc('"', out);
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\')
+            fprintf(out, "\\%c", ch);
+        else if (static_cast<unsigned char>(ch) < 0x20)
+            fprintf(out, "\\u%04x", ch);
+        else
+            fputc(ch, out);
+    }
+    fputc('"', out);
+}
+} // namespace detail
+
+//! Writes the trace to the given file, in binary form
+inline bool writeTraceFile(const char* path, const TraceData& data) {
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+    detail::TraceFileHeader header;
+    memcpy(header.magic_, detail::traceFileMagic, sizeof(header.magic_));
+    header.numThreads_ = data.numThreads_;
+    header.numPhilosophers_ = std::uint32_t(data.philosopherNames_.size());
+    header.numRecords_ = data.records_.size();
+    header.droppedRecords_ = data.droppedRecords_;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (const auto& name : data.philosopherNames_) {
+        std::uint32_t len = std::uint32_t(name.size());
+        ok = ok && fwrite(&len, sizeof(len), 1, f) == 1;
+        ok = ok && fwrite(name.data(), 1, len, f) == len;
+    }
+    ok = ok &&
+         fwrite(data.records_.data(), sizeof(TraceRecord), data.records_.size(), f) ==
+                 data.records_.size();
+    return fclose(f) == 0 && ok;
+}
+
+//! Reads a trace written by writeTraceFile()
+inline bool readTraceFile(const char* path, TraceData& data) {
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+    detail::TraceFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic_, detail::traceFileMagic, sizeof(header.magic_)) == 0;
+    if (ok) {
+        data.numThreads_ = header.numThreads_;
+        data.droppedRecords_ = header.droppedRecords_;
+        data.philosopherNames_.resize(header.numPhilosophers_);
+        for (auto& name : data.philosopherNames_) {
+            std::uint32_t len = 0;
+            ok = ok && fread(&len, sizeof(len), 1, f) == 1;
+            if (!ok)
+                break;
+            name.resize(len);
+            ok = fread(&name[0], 1, len, f) == len;
+        }
+    }
+    if (ok) {
+        data.records_.resize(header.numRecords_);
+        ok = fread(data.records_.data(), sizeof(TraceRecord), data.records_.size(), f) ==
+             data.records_.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+//! Prints a line for each philosopher, showing the activities over time, starting with the first
+//! event; each character covers 'stepMs' milliseconds. The records must be in chronological order.
+inline void printActivitySummaries(const TraceData& data, int stepMs = 5) {
+    std::uint64_t startNs = data.records_.empty() ? 0 : data.records_.front().timestamp_;
+
+    // Group the events by philosopher, keeping the chronological order
+    std::vector<std::vector<const TraceRecord*>> events(data.philosopherNames_.size());
+    for (const auto& rec : data.records_)
+        if (rec.philosopherIdx_ < events.size())
+            events[rec.philosopherIdx_].push_back(&rec);
+
+    for (std::size_t i = 0; i < events.size(); i++) {
+        printf("%15s: ", data.philosopherNames_[i].c_str());
+        char curFill = ' ';
+        int lastTimestamp = 0;
+        for (const TraceRecord* ev : events[i]) {
+            int timestamp = int((ev->timestamp_ - startNs) / 1000000);
+            int numCharsToFill = timestamp / stepMs - lastTimestamp / stepMs;
+            detail::printChars(curFill, numCharsToFill);
+
+            lastTimestamp = timestamp;
+            if (ev->isStart_)
+                curFill = detail::activityToChar(ActivityType(ev->activity_));
+            else
+                curFill = ' ';
+        }
+        detail::printChars(curFill, 1);
+        printf("\n");
+    }
+}
+
+//! Writes the trace in the Chrome trace event format (viewable in chrome://tracing or Perfetto).
+//! Each philosopher is shown as a thread; the thread that executed the activity is in the args.
+inline void writeChromeTrace(const TraceData& data, FILE* out) {
+    fprintf(out, "{\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&first, out] {
+        if (!first)
+            fprintf(out, ",\n");
+        first = false;
+    };
+    for (std::size_t i = 0; i < data.philosopherNames_.size(); i++) {
+        separator();
+        fprintf(out,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":",
+                unsigned(i));
+        detail::writeJsonString(out, data.philosopherNames_[i]);
+        fprintf(out, "}}");
+    }
+    for (const auto& rec : data.records_) {
+        // Leaving the table has no end; show it as an instant event
+        auto at = ActivityType(rec.activity_);
+        const char* phase = at == ActivityType::leave ? "i" : (rec.isStart_ ? "B" : "E");
+        if (at == ActivityType::leave && !rec.isStart_)
+            continue;
+        separator();
+        fprintf(out,
+                "{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":0,\"tid\":%u,"
+                "\"args\":{\"thread\":%u}}",
+                detail::activityToString(at), phase, rec.timestamp_ / 1000.0,
+                unsigned(rec.philosopherIdx_), unsigned(rec.threadIdx_));
+    }
+    fprintf(out, "\n]}\n");
+}
@@ -2,9 +2,13 @@
 
 #include "Protocol.hpp"
 #include "tasks/TaskSerializer.hpp"
+#include "tasks/NumaExecutor.hpp"
+#include "tasks/Future.hpp"
 
 #include <vector>
 
+class ForkLevelPhilosopherProtocol;
+
 /**
  * @brief      A synchronized fork
  *
@@ -15,26 +19,53 @@ class Fork {
 public:
     Fork(int forkIdx, TaskExecutorPtr executor)
         : forkIdx_(forkIdx)
-        , serializer_(executor) {}
-
-    void request(int philosopherIdx, TaskExecutorPtr executor, Task onSuccess, Task onFailure) {
-        serializer_.enqueue([this, philosopherIdx, executor, s = std::move(onSuccess),
-                                    f = std::move(onFailure)] {
-            if (!inUse_ || philosopherIdx_ == philosopherIdx) {
-                inUse_ = true;
-                philosopherIdx_ = philosopherIdx;
-                executor->enqueue(s);
-            } else
-                executor->enqueue(f);
+        , serializer_(executor, serializerOptions()) {}
+
+    //! Requests the fork for the given philosopher.
+    //! Returns a future indicating whether the fork was acquired; its continuations run on the
+    //! given executor.
+    Future<bool> request(int philosopherIdx, TaskExecutorPtr executor) {
+        Promise<bool> promise(std::move(executor));
+        Future<bool> res = promise.getFuture();
+        serializer_.enqueue([this, philosopherIdx, p = std::move(promise)]() mutable {
+            p.setValue(tryAcquire(philosopherIdx));
         });
+        return res;
     }
+    //! Returns the index of the fork
+    int index() const { return forkIdx_; }
+
     void release() {
-        serializer_.enqueue([this] {
-            inUse_ = false;
-        });
+        // Releasing the fork has priority; others may wait for it
+        serializer_.enqueue([this] { inUse_ = false; }, TaskPriority::high);
     }
 
+    //! Requests this fork and then the 'second' fork for the given philosopher.
+    //! The request is forwarded to the second fork from inside our serializer, and if the second
+    //! fork is not available, this fork is released. Only the final outcome is reported to the
+    //! philosopher. Only raw pointers travel with the request; the forks and the philosopher must
+    //! outlive it.
+    void requestPair(int philosopherIdx, Fork* second, ForkLevelPhilosopherProtocol* philosopher);
+
 private:
+    //! The options of the fork serializers. A fork is rarely contended, so most requests find its
+    //! serializer idle, and can be executed right away, on the requesting thread.
+    static TaskSerializerOptions serializerOptions() {
+        TaskSerializerOptions options;
+        options.tryRunInline = true;
+        return options;
+    }
+
+    //! Marks the fork as being in use by the given philosopher, if possible.
+    //! Must be called under our serializer.
+    bool tryAcquire(int philosopherIdx) {
+        if (inUse_ && philosopherIdx_ != philosopherIdx)
+            return false;
+        inUse_ = true;
+        philosopherIdx_ = philosopherIdx;
+        return true;
+    }
+
     //! The index of the fork
     int forkIdx_;
     //! Indicates if the fork is in used or not
@@ -49,11 +80,14 @@ using ForkPtr = std::shared_ptr<Fork>;
 
 class ForkLevelPhilosopherProtocol : public PhilosopherProtocol {
 public:
-    ForkLevelPhilosopherProtocol(
-            int philosopherIdx, ForkPtr leftFork, ForkPtr rightFork, TaskExecutorPtr executor)
+    //! Creates the protocol for the given philosopher. With 'orderedAcquisition', the forks are
+    //! requested in a chain, the lower-index fork first; otherwise both forks are requested in
+    //! parallel.
+    ForkLevelPhilosopherProtocol(int philosopherIdx, ForkPtr leftFork, ForkPtr rightFork,
+            TaskExecutorPtr executor, bool orderedAcquisition = false)
         : philosopherIdx_(philosopherIdx)
-        , serializer_(std::make_shared<TaskSerializer>(executor))
-        , executor_(executor) {
+        , executor_(executor)
+        , orderedAcquisition_(orderedAcquisition) {
         forks_[0] = leftFork;
         forks_[1] = rightFork;
     }
@@ -63,10 +97,7 @@ public:
         eatFailureTask_ = std::move(eatFailureTask);
         thinkTask_ = std::move(thinkTask);
         leaveTask_ = std::move(leaveTask);
-        forksTaken_[0] = false;
-        forksTaken_[1] = false;
-        forksResponses_ = 0;
-        executor_->enqueue(thinkTask); // Start by thinking
+        executor_->enqueue([this] { thinkTask_(); }); // Start by thinking
     }
     void onEatingDone(bool leavingTable) final {
         // Return the forks
@@ -74,40 +105,56 @@ public:
         forks_[1]->release();
         // Next action for the philosopher
         if (!leavingTable)
-            executor_->enqueue(thinkTask_);
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
         else
-            executor_->enqueue(leaveTask_);
+            executor_->enqueue([this] { leaveTask_(); });
     }
     void onThinkingDone() final {
-        forks_[0]->request(philosopherIdx_, serializer_, [this] { onForkStatus(0, true); },
-                [this] { onForkStatus(0, false); });
-        forks_[1]->request(philosopherIdx_, serializer_, [this] { onForkStatus(1, true); },
-                [this] { onForkStatus(1, false); });
+        if (orderedAcquisition_) {
+            // The right fork has the lower index only for the last philosopher
+            Fork* left = forks_[0].get();
+            Fork* right = forks_[1].get();
+            if (left->index() < right->index())
+                left->requestPair(philosopherIdx_, right, this);
+            else
+                right->requestPair(philosopherIdx_, left, this);
+            return;
+        }
+        // Request both forks, and continue when we have both responses
+        whenAll(forks_[0]->request(philosopherIdx_, executor_),
+                forks_[1]->request(philosopherIdx_, executor_))
+                .then([this](std::tuple<bool, bool> forksTaken) {
+                    onForksStatus(std::get<0>(forksTaken), std::get<1>(forksTaken));
+                });
+    }
+
+    //! Called from the serializer of the last fork of an ordered request, when we have both forks
+    void onForksAcquired() {
+        executor_->enqueue([this] { eatTask_(); });
+    }
+    //! Called from the serializer of a fork of an ordered request, when we could not get the forks;
+    //! the forks acquired by the request were already released
+    void onForksDenied() {
+        // Let the holders of the forks make progress before we retry
+        executor_->enqueue([this] { eatFailureTask_(); }, TaskPriority::low);
     }
 
 private:
-    void onForkStatus(int forkIdx, bool isAcquired) {
-        // Store the fork status
-        forksTaken_[forkIdx] = isAcquired;
-
-        // Do we have response from both forks?
-        if (++forksResponses_ == 2) {
-            if (forksTaken_[0] && forksTaken_[1]) {
-                // Success
-                executor_->enqueue(eatTask_);
-            } else {
-                // Release the forks
-                if (forksTaken_[0]) {
-                    forks_[0]->release();
-                }
-                if (forksTaken_[1]) {
-                    forks_[1]->release();
-                }
-                // Philosopher just had an eating failure
-                executor_->enqueue(eatFailureTask_);
-            }
-            // Reset this for the next round of eat request
-            forksResponses_ = 0;
+    //! Called when we have the responses from both forks; runs on our executor
+    void onForksStatus(bool leftTaken, bool rightTaken) {
+        if (leftTaken && rightTaken) {
+            // Success; we are already on the executor, so start eating right away
+            eatTask_();
+        } else {
+            // Release the forks
+            if (leftTaken)
+                forks_[0]->release();
+            if (rightTaken)
+                forks_[1]->release();
+            // Philosopher just had an eating failure. Let the holders of the forks make progress
+            // before we retry; retrying right away keeps taking the forks from each other. Also,
+            // the fork requests may complete inline, so retrying from here could recurse.
+            executor_->enqueue([this] { eatFailureTask_(); }, TaskPriority::low);
         }
     }
 
@@ -115,26 +162,54 @@ private:
     int philosopherIdx_;
     //! The forks near the philosopher
     ForkPtr forks_[2];
-    //! Indicates which forks are taken
-    bool forksTaken_[2]{false, false};
-    //! The number of responses got from the forks
-    int forksResponses_{0};
     //! The executor of the tasks
     TaskExecutorPtr executor_;
-    //! Serializer used to process notifications from the forks
-    std::shared_ptr<TaskSerializer> serializer_;
+    //! True if the forks are requested in a chain, the lower-index one first
+    bool orderedAcquisition_;
     //! The implementation of the actions that the philosopher does
     Task eatTask_, eatFailureTask_, thinkTask_, leaveTask_;
 };
 
+inline void Fork::requestPair(
+        int philosopherIdx, Fork* second, ForkLevelPhilosopherProtocol* philosopher) {
+    serializer_.enqueue([this, philosopherIdx, second, philosopher] {
+        if (!tryAcquire(philosopherIdx)) {
+            philosopher->onForksDenied();
+            return;
+        }
+        // We have this fork; go for the second one
+        second->serializer_.enqueue([this, philosopherIdx, second, philosopher] {
+            if (second->tryAcquire(philosopherIdx))
+                philosopher->onForksAcquired();
+            else {
+                // Roll back the acquisition of the first fork
+                release();
+                philosopher->onForksDenied();
+            }
+        });
+    });
+}
+
 class ForkLevelTableProtocol : public TableProtocol {
 public:
-    ForkLevelTableProtocol(int numSeats, TaskExecutorPtr executor)
-        : executor_(executor) {
+    //! Creates the forks of the table. With 'orderedAcquisition', each philosopher requests its
+    //! forks in a chain, the lower-index fork first, instead of requesting them in parallel.
+    ForkLevelTableProtocol(int numSeats, TaskExecutorPtr executor, bool orderedAcquisition = false)
+        : executor_(executor)
+        , orderedAcquisition_(orderedAcquisition) {
+        // If the executor is NUMA-aware, place the forks on the nodes in contiguous blocks, so that
+        // neighbor forks are (mostly) served by the same node
+        auto numaExecutor = std::dynamic_pointer_cast<NumaExecutor>(executor);
+
         // Create the forks
         forks_.reserve(numSeats);
-        for (int i = 0; i < numSeats; i++)
-            forks_.emplace_back(std::make_shared<Fork>(i, executor));
+        for (int i = 0; i < numSeats; i++) {
+            TaskExecutorPtr forkExecutor = executor;
+            if (numaExecutor)
+                forkExecutor = numaExecutor->nodeExecutor(
+                        int(long(i) * numaExecutor->numNodes() / numSeats));
+            forks_.emplace_back(std::make_shared<Fork>(i, forkExecutor));
+        }
     }
 
     std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) final {
@@ -144,7 +219,8 @@ public:
         ForkPtr leftFork = forks_[idx];
         ForkPtr rightFork = forks_[(idx + 1) % numSeats];
         return std::unique_ptr<PhilosopherProtocol>(
-                new ForkLevelPhilosopherProtocol(idx, leftFork, rightFork, executor_));
+                new ForkLevelPhilosopherProtocol(
+                        idx, leftFork, rightFork, executor_, orderedAcquisition_));
     }
 
 private:
@@ -152,4 +228,6 @@ private:
     std::vector<ForkPtr> forks_;
     //! The executor of the tasks
     TaskExecutorPtr executor_;
+    //! True if the philosophers request their forks in a chain, the lower-index one first
+    bool orderedAcquisition_;
 };
@@ -14,16 +14,16 @@ public:
         eatFailureTask_ = std::move(eatFailureTask);
         thinkTask_ = std::move(thinkTask);
         leaveTask_ = std::move(leaveTask);
-        executor_->enqueue(thinkTask);  // Start by thinking
+        executor_->enqueue([this] { thinkTask_(); });  // Start by thinking
     }
     void onEatingDone(bool leavingTable) final {
         if (!leavingTable)
-            executor_->enqueue(thinkTask_);
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
         else
-            executor_->enqueue(leaveTask_);
+            executor_->enqueue([this] { leaveTask_(); });
     }
     void onThinkingDone() final {
-        executor_->enqueue(eatTask_);
+        executor_->enqueue([this] { eatTask_(); });
     }
 
 private:
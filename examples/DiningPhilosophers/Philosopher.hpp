@@ -2,12 +2,46 @@
 
 #include "Protocol.hpp"
 #include "Utils.hpp"
+#include "EventTrace.hpp"
+#include "tasks/TimerExecutor.hpp"
 
-#include "tbb/atomic.h"
-
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string>
 #include <memory>
 
+//! Options controlling how a philosopher behaves at the dinner
+struct PhilosopherOptions {
+    //! How the philosopher eats and thinks
+    WorkMode workMode_{WorkMode::timer};
+    //! The executor used to wait for the end of the activities, in timer mode
+    std::shared_ptr<TimerExecutor> timer_;
+    //! If set, the activities of the philosopher are recorded in this tracer
+    EventTracer* tracer_{nullptr};
+    //! If set, decremented when the philosopher leaves the table
+    std::atomic<int>* numDining_{nullptr};
+    //! If set, the philosopher leaves the table early once this becomes true
+    const std::atomic<bool>* stopDinner_{nullptr};
+};
+
+//! Statistics about how well a philosopher did at the dinner
+struct PhilosopherStats {
+    //! The number of meals eaten
+    int meals_{0};
+    //! The number of times the philosopher wanted to eat, but couldn't
+    int eatFailures_{0};
+    //! The maximum number of failures in a row
+    int maxConsecutiveFailures_{0};
+    //! The longest time between getting hungry and starting to eat, in nanoseconds
+    std::int64_t maxHungryNs_{0};
+    //! The total time spent by the philosopher being hungry, in nanoseconds
+    std::int64_t totalHungryNs_{0};
+    //! The accumulated duration of the activities, if they are not really performed; in
+    //! microseconds, as if they were spinning
+    std::int64_t virtualTime_{0};
+};
+
 /**
  * @brief      Represents a philosopher at the dinner.
  *
@@ -20,9 +54,11 @@
  */
 class Philosopher {
 public:
-    Philosopher(const char* name)
+    Philosopher(const char* name, PhilosopherOptions options = {})
         : name_(name)
-        , eventLog_(name) {}
+        , options_(options)
+        , random_(std::uint32_t(std::hash<std::string>{}(name_)))
+        , eventLog_(options.tracer_, name) {}
 
     //! Called when the philosopher joins the dinner.
     //! It follows the protocol to consume the given number of meals.
@@ -42,49 +78,112 @@ public:
     //! Checks if the philosopher is done with the dinner
     bool isDone() const { return doneDining_; }
 
-    //! Getter for the event log of the philosopher
-    //! WARNING: Not thread-safe!
-    const PhilosopherEventLog& eventLog() const { return eventLog_; }
+    //! Getter for the statistics of the philosopher; valid after the philosopher is done
+    const PhilosopherStats& stats() const { return stats_; }
 
 private:
     //! The body of the eating task for the philosopher
     void doEat() {
-        eventLog_.startActivity(ActivityType::eat);
-        wait(randBetween(10, 50));
-        eventLog_.endActivity(ActivityType::eat);
+        std::int64_t hungryNs = getTicksNs() - hungrySince_;
+        stats_.maxHungryNs_ = std::max(stats_.maxHungryNs_, hungryNs);
+        stats_.totalHungryNs_ += hungryNs;
+        stats_.meals_++;
+        consecutiveFailures_ = 0;
+
+        logStart(ActivityType::eat);
+        work(10, 50, [this] {
+            logEnd(ActivityType::eat);
 
-        // According to the protocol, announce the end of eating
-        bool leavingTable = mealsRemaining_ > 1;
-        protocol_->onEatingDone(--mealsRemaining_ == 0);
+            // According to the protocol, announce the end of eating
+            protocol_->onEatingDone(--mealsRemaining_ == 0);
+        });
     }
     //! The body of the eating task for the philosopher
     void doEatFailure() {
-        eventLog_.startActivity(ActivityType::eatFailure);
-        wait(randBetween(5, 10));
-        eventLog_.endActivity(ActivityType::eatFailure);
+        stats_.eatFailures_++;
+        consecutiveFailures_++;
+        stats_.maxConsecutiveFailures_ =
+                std::max(stats_.maxConsecutiveFailures_, consecutiveFailures_);
+
+        logStart(ActivityType::eatFailure);
+        work(5, 10, [this] {
+            logEnd(ActivityType::eatFailure);
 
-        protocol_->onThinkingDone();
+            // We don't hold any forks, so we can leave right away if the dinner is stopped
+            if (isDinnerStopped())
+                doLeave();
+            else
+                protocol_->onThinkingDone();
+        });
     }
     //! The body of the thinking task for the philosopher
     void doThink() {
-        eventLog_.startActivity(ActivityType::think);
-        wait(randBetween(5, 30));
-        eventLog_.endActivity(ActivityType::think);
+        logStart(ActivityType::think);
+        work(5, 30, [this] {
+            logEnd(ActivityType::think);
 
-        protocol_->onThinkingDone();
+            // After thinking, the philosopher gets hungry
+            hungrySince_ = getTicksNs();
+
+            if (isDinnerStopped())
+                doLeave();
+            else
+                protocol_->onThinkingDone();
+        });
     }
     //! The body of the leaving task for the philosopher
     void doLeave() {
-        eventLog_.startActivity(ActivityType::leave);
+        logStart(ActivityType::leave);
         doneDining_ = true;
+        if (options_.numDining_)
+            options_.numDining_->fetch_sub(1, std::memory_order_release);
+    }
+
+    //! Checks if the dinner was stopped before all the meals were eaten
+    bool isDinnerStopped() const {
+        return options_.stopDinner_ && options_.stopDinner_->load(std::memory_order_relaxed);
     }
 
+    //! Performs the work for an activity, then calls 'onDone'.
+    //! The duration is chosen randomly in the given range. In timer mode, we don't block the
+    //! current thread; 'onDone' is enqueued to be executed when the activity completes.
+    template <typename F>
+    void work(int minDuration, int maxDuration, F&& onDone) {
+        int duration = random_.between(minDuration, maxDuration);
+        switch (options_.workMode_) {
+        case WorkMode::timer:
+            options_.timer_->enqueueAfter(
+                    std::chrono::milliseconds(duration), std::forward<F>(onDone));
+            return;
+        case WorkMode::spin:
+            spinFor(duration);
+            break;
+        case WorkMode::virtualTime:
+            stats_.virtualTime_ += duration;
+            break;
+        }
+        onDone();
+    }
+
+    void logStart(ActivityType at) { eventLog_.startActivity(at); }
+    void logEnd(ActivityType at) { eventLog_.endActivity(at); }
+
     //! The name of the philosopher.
     std::string name_;
+    //! The options for the philosopher's behavior
+    PhilosopherOptions options_;
     //! The number of meals remaining for the philosopher as part of the dinner.
     int mealsRemaining_{0};
+    //! The number of eat failures since the last meal
+    int consecutiveFailures_{0};
+    //! The time at which the philosopher last got hungry
+    std::int64_t hungrySince_{0};
+    //! Statistics about the dinner of this philosopher
+    PhilosopherStats stats_;
+    //! Random number generator for the durations of the activities
+    FastRandom random_;
     //! True if the philosopher is done dining and left the table
-    tbb::atomic<bool> doneDining_{false};
+    std::atomic<bool> doneDining_{false};
     //! The protocol to follow at the dinner.
     std::unique_ptr<PhilosopherProtocol> protocol_;
     //! The event log for this philosopher
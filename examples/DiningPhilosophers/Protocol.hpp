@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tasks/Task.hpp"
+#include "tasks/TaskSerializer.hpp"
 
 #include <memory>
 
@@ -37,3 +38,11 @@ struct TableProtocol {
     virtual std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) = 0;
 };
 
+//! The options for the serializers of the waiters.
+//! The waiter is a hot serializer, so let it drain multiple requests per hop.
+inline TaskSerializerOptions waiterSerializerOptions() {
+    TaskSerializerOptions options;
+    options.maxTasksPerHop = 32;
+    options.timeBudget = std::chrono::microseconds(200);
+    return options;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "Protocol.hpp"
+#include "tasks/TaskSerializer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief      Waiter that splits the table into shards, each with its own serializer.
+ *
+ * The forks are split into contiguous shards. Each shard keeps track of its forks, and serializes
+ * the access to them. A philosopher whose forks are in the same shard talks to a single serializer,
+ * just like with the central waiter. A philosopher at a shard boundary acquires the forks in two
+ * phases: first the fork from the shard with the lower index, then, from inside that shard's
+ * serializer, the fork from the other shard. If the second fork is not available, the first one is
+ * released.
+ *
+ * With one shard, this behaves like the central waiter; with one shard per fork, it behaves like
+ * having one serializer per fork. The number of shards trades serialization against messaging.
+ */
+class ShardedWaiter {
+public:
+    ShardedWaiter(int numSeats, int numShards, TaskExecutorPtr executor)
+        : numSeats_(numSeats)
+        , shardSize_((numSeats + std::max(numShards, 1) - 1) / std::max(numShards, 1))
+        , executor_(executor) {
+        for (int first = 0; first < numSeats; first += shardSize_)
+            shards_.emplace_back(
+                    new Shard(first, std::min(shardSize_, numSeats - first), executor));
+    }
+
+    //! Returns the actual number of shards
+    int numShards() const { return int(shards_.size()); }
+
+    void requestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats_;
+        Shard& shardLeft = shardOf(idxLeft);
+        Shard& shardRight = shardOf(idxRight);
+        if (&shardLeft == &shardRight) {
+            shardLeft.serializer_.enqueue([this, &shardLeft, idxLeft, idxRight,
+                                                  onSuccess = std::move(onSuccess),
+                                                  onFailure = std::move(onFailure)]() mutable {
+                // A failed philosopher retries right away; use a low priority to let the neighbor
+                // that holds the forks make progress first
+                if (shardLeft.tryAcquire(idxLeft, idxRight))
+                    executor_->enqueue(std::move(onSuccess)); // enqueue asap
+                else
+                    executor_->enqueue(std::move(onFailure), TaskPriority::low);
+            });
+        } else {
+            // The lower shard goes first; this is only reversed at the end of the table
+            if (idxRight < idxLeft)
+                requestBoundaryForks(idxRight, idxLeft, std::move(onSuccess), std::move(onFailure));
+            else
+                requestBoundaryForks(idxLeft, idxRight, std::move(onSuccess), std::move(onFailure));
+        }
+    }
+
+    void returnForks(int philosopherIdx) {
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats_;
+        Shard& shardLeft = shardOf(idxLeft);
+        Shard& shardRight = shardOf(idxRight);
+        // Returning the forks has priority; others may wait for them
+        if (&shardLeft == &shardRight) {
+            shardLeft.serializer_.enqueue(
+                    [&shardLeft, idxLeft, idxRight] { shardLeft.release(idxLeft, idxRight); },
+                    TaskPriority::high);
+        } else {
+            releaseFork(idxLeft);
+            releaseFork(idxRight);
+        }
+    }
+
+private:
+    //! A contiguous range of forks, with the serializer that protects them
+    struct Shard {
+        //! The index of the first fork in this shard
+        int firstFork_;
+        //! The forks of this shard, with flag indicating whether they are in use or not
+        std::vector<bool> forksInUse_;
+        //! Serializer object used to ensure serialized access to the forks of the shard
+        TaskSerializer serializer_;
+
+        Shard(int firstFork, int numForks, TaskExecutorPtr executor)
+            : firstFork_(firstFork)
+            , forksInUse_(numForks, false)
+            , serializer_(executor, waiterSerializerOptions()) {}
+
+        //! Marks the given forks as being in use, if none of them is in use
+        bool tryAcquire(int forkIdx1, int forkIdx2) {
+            if (forksInUse_[forkIdx1 - firstFork_] || forksInUse_[forkIdx2 - firstFork_])
+                return false;
+            forksInUse_[forkIdx1 - firstFork_] = true;
+            forksInUse_[forkIdx2 - firstFork_] = true;
+            return true;
+        }
+        bool tryAcquire(int forkIdx) { return tryAcquire(forkIdx, forkIdx); }
+
+        void release(int forkIdx1, int forkIdx2) {
+            assert(forksInUse_[forkIdx1 - firstFork_]);
+            assert(forksInUse_[forkIdx2 - firstFork_]);
+            forksInUse_[forkIdx1 - firstFork_] = false;
+            forksInUse_[forkIdx2 - firstFork_] = false;
+        }
+        void release(int forkIdx) { release(forkIdx, forkIdx); }
+    };
+
+    Shard& shardOf(int forkIdx) { return *shards_[forkIdx / shardSize_]; }
+
+    //! Acquires two forks from different shards: first 'firstIdx', then 'secondIdx'
+    void requestBoundaryForks(int firstIdx, int secondIdx, Task onSuccess, Task onFailure) {
+        Shard& firstShard = shardOf(firstIdx);
+        firstShard.serializer_.enqueue([this, &firstShard, firstIdx, secondIdx,
+                                               onSuccess = std::move(onSuccess),
+                                               onFailure = std::move(onFailure)]() mutable {
+            if (!firstShard.tryAcquire(firstIdx)) {
+                executor_->enqueue(std::move(onFailure), TaskPriority::low);
+                return;
+            }
+            // We have the first fork; go for the second one
+            Shard& secondShard = shardOf(secondIdx);
+            secondShard.serializer_.enqueue([this, &secondShard, firstIdx, secondIdx,
+                                                    onSuccess = std::move(onSuccess),
+                                                    onFailure = std::move(onFailure)]() mutable {
+                if (secondShard.tryAcquire(secondIdx))
+                    executor_->enqueue(std::move(onSuccess)); // enqueue asap
+                else {
+                    // Roll back the acquisition of the first fork
+                    releaseFork(firstIdx);
+                    executor_->enqueue(std::move(onFailure), TaskPriority::low);
+                }
+            });
+        });
+    }
+
+    //! Releases a single fork, under the serializer of its shard
+    void releaseFork(int forkIdx) {
+        Shard& shard = shardOf(forkIdx);
+        shard.serializer_.enqueue(
+                [&shard, forkIdx] { shard.release(forkIdx); }, TaskPriority::high);
+    }
+
+    //! The number of seats (and forks) at the table
+    int numSeats_;
+    //! The number of forks in each shard (except maybe the last one)
+    int shardSize_;
+    //! The shards of the table
+    std::vector<std::unique_ptr<Shard>> shards_;
+    //! The executor used to schedule tasks
+    TaskExecutorPtr executor_;
+};
+
+class ShardedWaiterPhilosopherProtocol : public PhilosopherProtocol {
+public:
+    ShardedWaiterPhilosopherProtocol(
+            int philosopherIdx, std::shared_ptr<ShardedWaiter> waiter, TaskExecutorPtr executor)
+        : philosopherIdx_(philosopherIdx)
+        , waiter_(waiter)
+        , executor_(executor) {}
+
+    void startDining(Task eatTask, Task eatFailureTask, Task thinkTask, Task leaveTask) final {
+        eatTask_ = std::move(eatTask);
+        eatFailureTask_ = std::move(eatFailureTask);
+        thinkTask_ = std::move(thinkTask);
+        leaveTask_ = std::move(leaveTask);
+        executor_->enqueue([this] { thinkTask_(); }); // Start by thinking
+    }
+    void onEatingDone(bool leavingTable) final {
+        // Return the forks
+        waiter_->returnForks(philosopherIdx_);
+        // Next action for the philosopher
+        if (!leavingTable)
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
+        else
+            executor_->enqueue([this] { leaveTask_(); });
+    }
+    void onThinkingDone() final {
+        waiter_->requestForks(
+                philosopherIdx_, [this] { eatTask_(); }, [this] { eatFailureTask_(); });
+    }
+
+private:
+    //! The index of the philosopher
+    int philosopherIdx_;
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<ShardedWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+    //! The implementation of the actions that the philosopher does
+    Task eatTask_, eatFailureTask_, thinkTask_, leaveTask_;
+};
+
+class ShardedWaiterTableProtocol : public TableProtocol {
+public:
+    ShardedWaiterTableProtocol(int numSeats, int numShards, TaskExecutorPtr executor)
+        : waiter_(std::make_shared<ShardedWaiter>(numSeats, numShards, executor))
+        , executor_(executor) {}
+
+    std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) final {
+        return std::unique_ptr<PhilosopherProtocol>(
+                new ShardedWaiterPhilosopherProtocol(idx, waiter_, executor_));
+    }
+
+private:
+    //! The waiter who is responsible for handling and receiving the forks
+    std::shared_ptr<ShardedWaiter> waiter_;
+    //! The executor of the tasks
+    TaskExecutorPtr executor_;
+};
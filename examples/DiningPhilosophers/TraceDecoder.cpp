@@ -0,0 +1,73 @@
+#include "EventTrace.hpp"
+#include "utils/CommandLine.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+//! The settings of the decoder
+struct DecoderOptions {
+    //! The trace file to decode
+    std::string tracePath_;
+    //! If true, print the activities of the philosophers, as the dinner program does
+    bool printSummary_{false};
+    //! The number of milliseconds covered by one character of the summary
+    int stepMs_{5};
+    //! If not empty, export the trace in the Chrome trace event format to this file
+    std::string chromePath_;
+};
+
+bool parseOptions(int argc, char** argv, DecoderOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (strcmp(argv[i], "--summary") == 0)
+            options.printSummary_ = true;
+        else if (matchArg(argv[i], "--summary=", value)) {
+            options.printSummary_ = true;
+            options.stepMs_ = std::atoi(value.c_str());
+        } else if (matchArg(argv[i], "--chrome=", value))
+            options.chromePath_ = value;
+        else if (argv[i][0] != '-' && options.tracePath_.empty())
+            options.tracePath_ = argv[i];
+        else
+            return false;
+    }
+    // Without anything else to do, print the summary
+    if (options.chromePath_.empty())
+        options.printSummary_ = true;
+    return !options.tracePath_.empty() && options.stepMs_ >= 1;
+}
+
+int main(int argc, char** argv) {
+    DecoderOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s TRACE_FILE [--summary[=STEP_MS]] [--chrome=OUTPUT_JSON]\n",
+                argv[0]);
+        return 1;
+    }
+
+    TraceData trace;
+    if (!readTraceFile(options.tracePath_.c_str(), trace)) {
+        fprintf(stderr, "Cannot read the trace file: %s\n", options.tracePath_.c_str());
+        return 1;
+    }
+    printf("philosophers:            %lu\n", (unsigned long)trace.philosopherNames_.size());
+    printf("threads:                 %u\n", unsigned(trace.numThreads_));
+    printf("events:                  %lu\n", (unsigned long)trace.records_.size());
+    printf("dropped events:          %lu\n", (unsigned long)trace.droppedRecords_);
+
+    if (options.printSummary_) {
+        printf("\n");
+        printActivitySummaries(trace, options.stepMs_);
+    }
+    if (!options.chromePath_.empty()) {
+        FILE* out = fopen(options.chromePath_.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write the Chrome trace: %s\n", options.chromePath_.c_str());
+            return 1;
+        }
+        writeChromeTrace(trace, out);
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+// Checks the fair waiter (WaiterFair) against the policy of its previous implementation, which kept
+// the denied philosophers in a waiting list. Replays random sequences of fork requests and returns,
+// on tables of 2 to 17 seats, through both, and checks that they make the same decisions. Also
+// checks the fairness rule directly: a philosopher never gets the forks while its right neighbor
+// has been waiting for longer.
+//
+// The tasks are executed inline, so the waiter makes its decisions deterministically, in the order
+// of the requests. Prints the number of decisions checked; fails if any check fails.
+
+#include "WaiterFairProtocol.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+//! Executor that runs the tasks right away, on the enqueuing thread
+class InlineExecutor : public TaskExecutor {
+public:
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority) override { t(); }
+};
+
+//! The policy of the previous WaiterFair: the denied philosophers are kept in a list, in the order
+//! of their first denied request; a request is denied if the forks are in use, or if the right
+//! neighbor is in the list before the requesting philosopher
+class WaitingListPolicy {
+public:
+    explicit WaitingListPolicy(int numSeats)
+        : forksInUse_(numSeats, false) {}
+
+    bool requestForks(int philosopherIdx) {
+        int numSeats = int(forksInUse_.size());
+        int idxLeft = philosopherIdx;
+        int idxRight = (philosopherIdx + 1) % numSeats;
+
+        bool canEat = !forksInUse_[idxLeft] && !forksInUse_[idxRight];
+        if (canEat) {
+            for (int i = 0; i < int(waitingList_.size()); i++) {
+                int phId = waitingList_[i];
+                if (phId == philosopherIdx) {
+                    waitingList_.erase(waitingList_.begin() + i);
+                    break;
+                } else if (phId == idxRight) {
+                    canEat = false;
+                    break;
+                }
+            }
+        }
+
+        if (canEat) {
+            forksInUse_[idxLeft] = true;
+            forksInUse_[idxRight] = true;
+        } else if (std::find(waitingList_.begin(), waitingList_.end(), philosopherIdx) ==
+                   waitingList_.end())
+            waitingList_.push_back(philosopherIdx);
+        return canEat;
+    }
+
+    void returnForks(int philosopherIdx) {
+        int numSeats = int(forksInUse_.size());
+        forksInUse_[philosopherIdx] = false;
+        forksInUse_[(philosopherIdx + 1) % numSeats] = false;
+    }
+
+private:
+    std::vector<bool> forksInUse_;
+    std::vector<int> waitingList_;
+};
+
+//! The outcome of checking a number of random sequences
+struct CheckResult {
+    long numDecisions_{0};
+    long numMismatches_{0};
+    long numUnfairDecisions_{0};
+};
+
+//! Replays a random sequence of requests and returns on a table with the given number of seats
+void checkSequence(int numSeats, int numSteps, std::mt19937& rng, CheckResult& res) {
+    auto executor = std::make_shared<InlineExecutor>();
+    WaiterFair waiter(numSeats, executor);
+    WaitingListPolicy reference(numSeats);
+
+    std::vector<bool> eating(numSeats, false);
+    // The step of the first denied request of each waiting philosopher; -1 if not waiting
+    std::vector<long> waitingSince(numSeats, -1);
+    std::uniform_int_distribution<int> pickPhilosopher(0, numSeats - 1);
+
+    for (int step = 0; step < numSteps; step++) {
+        int idx = pickPhilosopher(rng);
+        if (eating[idx]) {
+            waiter.returnForks(idx);
+            reference.returnForks(idx);
+            eating[idx] = false;
+            continue;
+        }
+
+        bool acquired = false;
+        waiter.requestForks(idx, [&acquired] { acquired = true; }, [] {});
+        bool expected = reference.requestForks(idx);
+        res.numDecisions_++;
+        if (acquired != expected)
+            res.numMismatches_++;
+
+        int rightIdx = (idx + 1) % numSeats;
+        if (acquired) {
+            long rightSince = waitingSince[rightIdx];
+            if (rightIdx != idx && rightSince >= 0 &&
+                    (waitingSince[idx] < 0 || rightSince < waitingSince[idx]))
+                res.numUnfairDecisions_++;
+            eating[idx] = true;
+            waitingSince[idx] = -1;
+        } else if (waitingSince[idx] < 0)
+            waitingSince[idx] = step;
+    }
+
+    // Let the waiter finish with the forks still in use
+    for (int i = 0; i < numSeats; i++)
+        if (eating[i])
+            waiter.returnForks(i);
+}
+
+} // namespace
+
+int main() {
+    constexpr int minSeats = 2;
+    constexpr int maxSeats = 17;
+    constexpr int numSequencesPerTable = 2000;
+    constexpr int numSteps = 100;
+
+    std::mt19937 rng(12345);
+    CheckResult res;
+    for (int numSeats = minSeats; numSeats <= maxSeats; numSeats++)
+        for (int i = 0; i < numSequencesPerTable; i++)
+            checkSequence(numSeats, numSteps, rng, res);
+
+    printf("decisions,mismatches,unfair_decisions\n");
+    printf("%ld,%ld,%ld\n", res.numDecisions_, res.numMismatches_, res.numUnfairDecisions_);
+    if (res.numMismatches_ != 0) {
+        fprintf(stderr, "%ld decisions differ from the waiting-list policy\n", res.numMismatches_);
+        return 1;
+    }
+    if (res.numUnfairDecisions_ != 0) {
+        fprintf(stderr, "%ld philosophers got the forks before their waiting neighbor\n",
+                res.numUnfairDecisions_);
+        return 1;
+    }
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include "Protocol.hpp"
 #include "tasks/TaskSerializer.hpp"
 
+#include <cstdint>
 #include <vector>
 
 /**
@@ -12,59 +13,55 @@
  * Each philosopher will request the forks to the waiter. The access to the waiter is serialized.
  * That is, only one philosopher can talk to the waiter at a given time.
  *
- * This Waiter implements a fair policy. It keeps a waiting lists of the philosophers that requested
- * the forks and did not get them. If one requests the forks, and one of the neighbors are still
- * waiting for the forks, then deny the request.
+ * This Waiter implements a fair policy. It keeps track of the philosophers that requested the forks
+ * and did not get them, in the order of their first failed request. If one requests the forks, and
+ * the right neighbor (the one sharing the right fork) has been waiting for longer, then deny the
+ * request. Only one side is checked: checking both sides lets chains of waiting philosophers block
+ * each other along the table.
+ *
+ * The order of the waiting philosophers is given by tickets: each philosopher that starts waiting
+ * gets a ticket with the next number; a philosopher that is not waiting has ticket zero. Only the
+ * relative order of neighbors matters, so comparing two tickets is enough; the time spent under the
+ * serializer doesn't depend on the number of seats.
  */
 class WaiterFair {
 public:
     WaiterFair(int numSeats, TaskExecutorPtr executor)
         : executor_(executor)
-        , serializer_(executor) {
+        , serializer_(executor, waiterSerializerOptions()) {
         // Arrange the forks on the table; they are not in use at this time
         forksInUse_.resize(numSeats, false);
-        // The waiting queue is bounded by the number of seats
-        waitingQueue_.reserve(numSeats);
+        // Nobody is waiting at this point
+        waitTickets_.resize(numSeats, 0);
     }
 
     void requestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
         serializer_.enqueue([this, philosopherIdx, onSuccess = std::move(onSuccess),
-                                    onFailure = std::move(onFailure)] {
+                                    onFailure = std::move(onFailure)]() mutable {
             this->doRequestForks(philosopherIdx, std::move(onSuccess), std::move(onFailure));
         });
     }
 
     void returnForks(int philosopherIdx) {
-        serializer_.enqueue([this, philosopherIdx] { this->doReturnForks(philosopherIdx); });
+        // Returning the forks has priority; others may wait for them
+        serializer_.enqueue(
+                [this, philosopherIdx] { this->doReturnForks(philosopherIdx); },
+                TaskPriority::high);
     }
 
 private:
     //! Called when a philosopher requests the forks for eating.
-    //! If the forks are available, and there is nobody before in the waiting queue, accept the fork
-    //! request. Otherwise, deny it, and make sure that the philosopher is in the waiting queue.
+    //! If the forks are available, and the neighbor is not waiting for longer, accept the request.
+    //! Otherwise, deny it, and make sure that the philosopher is marked as waiting.
     void doRequestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
         int numSeats = forksInUse_.size();
         int idxLeft = philosopherIdx;
         int idxRight = (philosopherIdx + 1) % numSeats;
 
         bool canEat = !forksInUse_[idxLeft] && !forksInUse_[idxRight];
-        if ( canEat ) {
-            // Ensure that the neighbors are not in the waiting queue before this one
-            for ( int i=0; i<int(waitingQueue_.size()); i++) {
-                int phId = waitingQueue_[i];
-                if (phId == philosopherIdx) {
-                    // We found ourselves in the list, before any of the neighbors.
-                    // Remove ourselves from the waiting list and approve the eating.
-                    waitingQueue_.erase(waitingQueue_.begin() + i);
-                    break;
-                }
-                else if (phId == idxLeft || phId == idxRight) {
-                    // A neighbor is before us in the waiting list.
-                    // Deny the eating.
-                    canEat = false;
-                    break;
-                }
-            }
+        if (canEat) {
+            // Ensure that the right neighbor did not start waiting before this one
+            canEat = !isWaitingBefore(idxRight, philosopherIdx);
         }
 
         if (canEat) {
@@ -73,19 +70,27 @@ private:
             forksInUse_[idxLeft] = true;
             forksInUse_[idxRight] = true;
 
-            // The philosopher should not be in the waiting queue anymore
-            assert(std::find(waitingQueue_.begin(), waitingQueue_.end(), philosopherIdx) ==
-                    waitingQueue_.end());
+            // The philosopher is not waiting anymore
+            waitTickets_[philosopherIdx] = 0;
         } else {
-            executor_->enqueue(std::move(onFailure)); // enqueue asap
+            // The philosopher retries right away; use a low priority to let the neighbors that
+            // hold the forks make progress first
+            executor_->enqueue(std::move(onFailure), TaskPriority::low);
 
-            // Ensure that this philosopher is on the list; if it's not, add it
-            auto it = std::find(waitingQueue_.begin(), waitingQueue_.end(), philosopherIdx);
-            if (it == waitingQueue_.end())
-                waitingQueue_.push_back(philosopherIdx);
+            // Ensure that this philosopher is marked as waiting; keep the original ticket
+            if (waitTickets_[philosopherIdx] == 0)
+                waitTickets_[philosopherIdx] = nextTicket_++;
         }
     }
 
+    //! Checks if philosopher 'idx' started waiting before philosopher 'otherIdx'.
+    //! A philosopher that is not waiting is considered to be after all the waiting ones.
+    bool isWaitingBefore(int idx, int otherIdx) const {
+        std::uint64_t ticket = waitTickets_[idx];
+        std::uint64_t otherTicket = waitTickets_[otherIdx];
+        return ticket != 0 && (otherTicket == 0 || ticket < otherTicket);
+    }
+
     //! Called when a philosopher is done eating and returns the forks
     void doReturnForks(int philosopherIdx) {
         int numSeats = forksInUse_.size();
@@ -99,8 +104,10 @@ private:
 
     //! The forks on the table, with flag indicating whether they are in use or not
     std::vector<bool> forksInUse_;
-    //! The eat requests that are failed, in order
-    std::vector<int> waitingQueue_;
+    //! The ticket of each philosopher that is waiting for the forks; zero if not waiting
+    std::vector<std::uint64_t> waitTickets_;
+    //! The ticket to be given to the next philosopher that starts waiting
+    std::uint64_t nextTicket_{1};
     //! The executor used to schedule tasks
     TaskExecutorPtr executor_;
     //! Serializer object used to ensure serialized accessed to the waiter
@@ -120,19 +127,20 @@ public:
         eatFailureTask_ = std::move(eatFailureTask);
         thinkTask_ = std::move(thinkTask);
         leaveTask_ = std::move(leaveTask);
-        executor_->enqueue(thinkTask);  // Start by thinking
+        executor_->enqueue([this] { thinkTask_(); });  // Start by thinking
     }
     void onEatingDone(bool leavingTable) final {
         // Return the forks
         waiter_->returnForks(philosopherIdx_);
         // Next action for the philosopher
         if (!leavingTable)
-            executor_->enqueue(thinkTask_);
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
         else
-            executor_->enqueue(leaveTask_);
+            executor_->enqueue([this] { leaveTask_(); });
     }
     void onThinkingDone() final {
-        waiter_->requestForks(philosopherIdx_, eatTask_, eatFailureTask_);
+        waiter_->requestForks(
+                philosopherIdx_, [this] { eatTask_(); }, [this] { eatFailureTask_(); });
     }
 
 private:
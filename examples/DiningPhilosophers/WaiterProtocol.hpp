@@ -11,44 +11,78 @@
  * The waiter is needed to ensure a synchronization point between philosophers.
  * Each philosopher will request the forks to the waiter. The access to the waiter is serialized.
  * That is, only one philosopher can talk to the waiter at a given time.
+ *
+ * If the forks are not available, the request is denied, or, if the philosopher doesn't provide a
+ * failure task, parked until the forks become available. When a philosopher returns the forks, the
+ * waiter directly serves the parked neighbors that can now eat; they don't need to poll.
  */
 class Waiter {
 public:
     Waiter(int numSeats, TaskExecutorPtr executor)
         : executor_(executor)
-        , serializer_(executor) {
+        , serializer_(executor, waiterSerializerOptions()) {
         // Arrange the forks on the table; they are not in use at this time
         forksInUse_.resize(numSeats, false);
+        parkedRequests_.resize(numSeats);
     }
 
-    void requestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
+    //! Requests the forks for the given philosopher. If the forks are available, executes the
+    //! onSuccess task. Otherwise, executes the onFailure task, or, if that is empty, parks the
+    //! request until the forks become available.
+    void requestForks(int philosopherIdx, Task onSuccess, Task onFailure = {}) {
         serializer_.enqueue([this, philosopherIdx, onSuccess = std::move(onSuccess),
-                                    onFailure = std::move(onFailure)] {
+                                    onFailure = std::move(onFailure)]() mutable {
             this->doRequestForks(philosopherIdx, std::move(onSuccess), std::move(onFailure));
         });
     }
 
     void returnForks(int philosopherIdx) {
-        serializer_.enqueue([this, philosopherIdx] { this->doReturnForks(philosopherIdx); });
+        // Returning the forks has priority; others may wait for them
+        serializer_.enqueue(
+                [this, philosopherIdx] { this->doReturnForks(philosopherIdx); },
+                TaskPriority::high);
+    }
+
+    //! Cancels the parked request of the given philosopher, executing the onCancelled task.
+    //! Does nothing if the request was already served. Can be used to implement timeouts.
+    void cancelRequest(int philosopherIdx, Task onCancelled) {
+        serializer_.enqueue([this, philosopherIdx, onCancelled = std::move(onCancelled)]() mutable {
+            Task& parked = parkedRequests_[philosopherIdx];
+            if (parked) {
+                parked = nullptr;
+                executor_->enqueue(std::move(onCancelled));
+            }
+        });
     }
 
 private:
     //! Called when a philosopher requests the forks for eating.
     //! If the forks are available, mark them as being in use and execute the onSucceess task.
-    //! If the forks are not available, execute the onFailure task.
+    //! If the forks are not available, execute the onFailure task, or park the request.
     //! This is always called under our serializer.
     void doRequestForks(int philosopherIdx, Task onSuccess, Task onFailure) {
+        if (tryGiveForks(philosopherIdx, onSuccess))
+            return;
+        // A failed philosopher retries right away; use a low priority to let the neighbor that
+        // holds the forks make progress first
+        if (onFailure)
+            executor_->enqueue(std::move(onFailure), TaskPriority::low);
+        else
+            parkedRequests_[philosopherIdx] = std::move(onSuccess);
+    }
+
+    //! If the forks of the philosopher are available, mark them as being in use and execute the
+    //! onSuccess task. This is always called under our serializer.
+    bool tryGiveForks(int philosopherIdx, Task& onSuccess) {
         int numSeats = forksInUse_.size();
         int idxLeft = philosopherIdx;
         int idxRight = (philosopherIdx + 1) % numSeats;
-
-        if (!forksInUse_[idxLeft] && !forksInUse_[idxRight]) {
-            executor_->enqueue(std::move(onSuccess)); // enqueue asap
-            forksInUse_[idxLeft] = true;
-            forksInUse_[idxRight] = true;
-        } else {
-            executor_->enqueue(std::move(onFailure));
-        }
+        if (forksInUse_[idxLeft] || forksInUse_[idxRight])
+            return false;
+        executor_->enqueue(std::move(onSuccess)); // enqueue asap
+        forksInUse_[idxLeft] = true;
+        forksInUse_[idxRight] = true;
+        return true;
     }
 
     //! Called when a philosopher is done eating and returns the forks
@@ -60,10 +94,19 @@ private:
         assert(forksInUse_[idxRight]);
         forksInUse_[idxLeft] = false;
         forksInUse_[idxRight] = false;
+
+        // Serve the parked neighbors that can now eat
+        for (int neighborIdx : {(philosopherIdx + numSeats - 1) % numSeats, idxRight}) {
+            Task& parked = parkedRequests_[neighborIdx];
+            if (parked)
+                tryGiveForks(neighborIdx, parked);
+        }
     }
 
     //! The forks on the table, with flag indicating whether they are in use or not
     std::vector<bool> forksInUse_;
+    //! The onSuccess tasks of the parked requests, for each seat; empty if no parked request
+    std::vector<Task> parkedRequests_;
     //! The executor used to schedule tasks
     TaskExecutorPtr executor_;
     //! Serializer object used to ensure serialized accessed to the waiter
@@ -72,30 +115,35 @@ private:
 
 class WaiterPhilosopherProtocol : public PhilosopherProtocol {
 public:
-    WaiterPhilosopherProtocol(
-            int philosopherIdx, std::shared_ptr<Waiter> waiter, TaskExecutorPtr executor)
+    WaiterPhilosopherProtocol(int philosopherIdx, std::shared_ptr<Waiter> waiter,
+            TaskExecutorPtr executor, bool parkRequests)
         : philosopherIdx_(philosopherIdx)
         , waiter_(waiter)
-        , executor_(executor) {}
+        , executor_(executor)
+        , parkRequests_(parkRequests) {}
 
     void startDining(Task eatTask, Task eatFailureTask, Task thinkTask, Task leaveTask) final {
         eatTask_ = std::move(eatTask);
         eatFailureTask_ = std::move(eatFailureTask);
         thinkTask_ = std::move(thinkTask);
         leaveTask_ = std::move(leaveTask);
-        executor_->enqueue(thinkTask);  // Start by thinking
+        executor_->enqueue([this] { thinkTask_(); });  // Start by thinking
     }
     void onEatingDone(bool leavingTable) final {
         // Return the forks
         waiter_->returnForks(philosopherIdx_);
         // Next action for the philosopher
         if (!leavingTable)
-            executor_->enqueue(thinkTask_);
+            executor_->enqueue([this] { thinkTask_(); }, TaskPriority::low);
         else
-            executor_->enqueue(leaveTask_);
+            executor_->enqueue([this] { leaveTask_(); });
     }
     void onThinkingDone() final {
-        waiter_->requestForks(philosopherIdx_, eatTask_, eatFailureTask_);
+        if (parkRequests_)
+            waiter_->requestForks(philosopherIdx_, [this] { eatTask_(); });
+        else
+            waiter_->requestForks(
+                    philosopherIdx_, [this] { eatTask_(); }, [this] { eatFailureTask_(); });
     }
 
 private:
@@ -105,19 +153,24 @@ private:
     std::shared_ptr<Waiter> waiter_;
     //! The executor of the tasks
     TaskExecutorPtr executor_;
+    //! True if we wait for the forks, instead of retrying after an eat failure
+    bool parkRequests_;
     //! The implementation of the actions that the philosopher does
     Task eatTask_, eatFailureTask_, thinkTask_, leaveTask_;
 };
 
 class WaiterTableProtocol : public TableProtocol {
 public:
-    WaiterTableProtocol(int numSeats, TaskExecutorPtr executor)
+    //! Creates the protocol. If 'parkRequests' is set, the philosophers wait for the waiter to give
+    //! them the forks, instead of failing to eat and asking again.
+    WaiterTableProtocol(int numSeats, TaskExecutorPtr executor, bool parkRequests = false)
         : waiter_(std::make_shared<Waiter>(numSeats, executor))
-        , executor_(executor) {}
+        , executor_(executor)
+        , parkRequests_(parkRequests) {}
 
     std::unique_ptr<PhilosopherProtocol> createPhilosopherProtocol(int idx) final {
         return std::unique_ptr<PhilosopherProtocol>(
-                new WaiterPhilosopherProtocol(idx, waiter_, executor_));
+                new WaiterPhilosopherProtocol(idx, waiter_, executor_, parkRequests_));
     }
 
 private:
@@ -125,4 +178,6 @@ private:
     std::shared_ptr<Waiter> waiter_;
     //! The executor of the tasks
     TaskExecutorPtr executor_;
+    //! True if the philosophers wait for the forks, instead of retrying
+    bool parkRequests_;
 };
@@ -1,23 +1,64 @@
 #include "tasks/GlobalTaskExecutor.hpp"
 
-#include "tbb/task.h"
+#include <thread>
 
-//! Wrapper to transform our Task into a TBB task
-struct TaskWrapper : tbb::task {
-    Task ftor_;
+// Note: we don't reserve arena slots for external threads; no thread joins the arena, all the
+// tasks are enqueued.
 
-    TaskWrapper(Task t)
-        : ftor_(std::move(t)) {}
+thread_local const GlobalTaskExecutor* GlobalTaskExecutor::currentExecutor_ = nullptr;
 
-    tbb::task* execute() {
-        ftor_();
-        return nullptr;
+GlobalTaskExecutor::GlobalTaskExecutor(int concurrency, Priority priority)
+    : arena_(concurrency, 0, priority) {
+    arena_.initialize();
+}
+
+GlobalTaskExecutor::GlobalTaskExecutor(tbb::task_arena::constraints constraints, Priority priority)
+    : arena_(constraints, 0, priority) {
+    arena_.initialize();
+}
+
+GlobalTaskExecutor::~GlobalTaskExecutor() {
+    // Discard the tasks not yet executed, so that the pending arena tasks finish quickly, and wait
+    // for all the arena tasks to finish; they access our queues.
+    while (numArenaTasks_.load(std::memory_order_acquire) != 0) {
+        QueuedTask t;
+        for (auto& tasks : tasks_)
+            while (tasks.try_pop(t))
+                t.task_ = nullptr;
+        std::this_thread::yield();
     }
-};
+}
 
-GlobalTaskExecutor::GlobalTaskExecutor() {}
+void GlobalTaskExecutor::enqueue(Task t, TaskPriority prio) {
+#if TASKS_INSTRUMENTATION
+    counters_.onEnqueue();
+#endif
+    numArenaTasks_.fetch_add(1, std::memory_order_relaxed);
+    tasks_[int(prio)].push(QueuedTask{std::move(t)});
+    // Each arena task runs exactly one of our tasks, so no task is left behind
+    arena_.enqueue([this] { runOneTask(); });
+}
 
-void GlobalTaskExecutor::enqueue(Task t) {
-    auto& tbbTask = *new (tbb::task::allocate_root()) TaskWrapper(std::move(t));
-    tbb::task::enqueue(tbbTask);
-}
\ No newline at end of file
+void GlobalTaskExecutor::runOneTask() {
+    {
+        QueuedTask t;
+        for (int prio = numTaskPriorities - 1; prio >= 0; prio--) {
+            if (tasks_[prio].try_pop(t)) {
+                // TBB may run our task while waiting inside a task of another arena
+                const GlobalTaskExecutor* prevExecutor = currentExecutor_;
+                currentExecutor_ = this;
+#if TASKS_INSTRUMENTATION
+                auto startTimeNs = counters_.onStart(t.enqueueTimeNs_);
+                t.task_();
+                counters_.onEnd(startTimeNs);
+#else
+                t.task_();
+#endif
+                currentExecutor_ = prevExecutor;
+                break;
+            }
+        }
+    }
+    // Must be the last access to the executor; the destructor may complete right after it
+    numArenaTasks_.fetch_sub(1, std::memory_order_release);
+}
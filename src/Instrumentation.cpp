@@ -0,0 +1,135 @@
+#include "tasks/Instrumentation.hpp"
+
+#include <chrono>
+
+constexpr int TimeHistogram::numBuckets;
+constexpr int ExecutorCounters::numShards;
+
+int TimeHistogram::bucketFor(std::int64_t ns) {
+    int bucket = 0;
+    while (ns > 0 && bucket < numBuckets - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+std::uint64_t TimeHistogram::count() const {
+    std::uint64_t res = 0;
+    for (auto c : counts_)
+        res += c;
+    return res;
+}
+
+std::int64_t TimeHistogram::percentileNs(double p) const {
+    std::uint64_t total = count();
+    if (total == 0)
+        return 0;
+    std::uint64_t target = std::uint64_t(p * total);
+    if (target == 0)
+        target = 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < numBuckets; i++) {
+        seen += counts_[i];
+        if (seen >= target)
+            return i == 0 ? 0 : std::int64_t(1) << i;
+    }
+    return std::int64_t(1) << (numBuckets - 1);
+}
+
+//! The counters updated by the threads that map to the same shard
+struct ExecutorCounters::Shard {
+    std::atomic<std::uint64_t> tasksEnqueued_{0};
+    std::atomic<std::uint64_t> tasksExecuted_{0};
+    std::atomic<std::uint64_t> busyEnqueues_{0};
+    std::atomic<std::uint64_t> queueLatency_[TimeHistogram::numBuckets];
+    std::atomic<std::uint64_t> executionTime_[TimeHistogram::numBuckets];
+
+    Shard() {
+        for (auto& c : queueLatency_)
+            c.store(0, std::memory_order_relaxed);
+        for (auto& c : executionTime_)
+            c.store(0, std::memory_order_relaxed);
+    }
+};
+
+ExecutorCounters::ExecutorCounters() {
+    for (auto& shard : shards_)
+        shard.store(nullptr, std::memory_order_relaxed);
+}
+
+ExecutorCounters::~ExecutorCounters() {
+    for (auto& shard : shards_)
+        delete shard.load(std::memory_order_relaxed);
+}
+
+std::int64_t ExecutorCounters::nowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void ExecutorCounters::onEnqueue() {
+    localShard().tasksEnqueued_.fetch_add(1, std::memory_order_relaxed);
+    std::int64_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::int64_t maxDepth = maxDepth_.load(std::memory_order_relaxed);
+    while (depth > maxDepth &&
+            !maxDepth_.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed)) {
+    }
+}
+
+void ExecutorCounters::onFoundBusy() {
+    localShard().busyEnqueues_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::int64_t ExecutorCounters::onStart(std::int64_t enqueueTimeNs) {
+    std::int64_t now = nowNs();
+    localShard()
+            .queueLatency_[TimeHistogram::bucketFor(now - enqueueTimeNs)]
+            .fetch_add(1, std::memory_order_relaxed);
+    return now;
+}
+
+void ExecutorCounters::onEnd(std::int64_t startTimeNs) {
+    Shard& shard = localShard();
+    shard.executionTime_[TimeHistogram::bucketFor(nowNs() - startTimeNs)].fetch_add(
+            1, std::memory_order_relaxed);
+    shard.tasksExecuted_.fetch_add(1, std::memory_order_relaxed);
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ExecutorCountersSnapshot ExecutorCounters::snapshot() const {
+    ExecutorCountersSnapshot res;
+    for (const auto& s : shards_) {
+        const Shard* shard = s.load(std::memory_order_acquire);
+        if (!shard)
+            continue;
+        res.tasksEnqueued_ += shard->tasksEnqueued_.load(std::memory_order_relaxed);
+        res.tasksExecuted_ += shard->tasksExecuted_.load(std::memory_order_relaxed);
+        res.busyEnqueues_ += shard->busyEnqueues_.load(std::memory_order_relaxed);
+        for (int i = 0; i < TimeHistogram::numBuckets; i++) {
+            res.queueLatency_.counts_[i] += shard->queueLatency_[i].load(std::memory_order_relaxed);
+            res.executionTime_.counts_[i] +=
+                    shard->executionTime_[i].load(std::memory_order_relaxed);
+        }
+    }
+    res.depth_ = depth_.load(std::memory_order_relaxed);
+    res.maxDepth_ = maxDepth_.load(std::memory_order_relaxed);
+    return res;
+}
+
+ExecutorCounters::Shard& ExecutorCounters::localShard() {
+    static std::atomic<int> numThreads{0};
+    static thread_local int shardIdx = numThreads.fetch_add(1) % numShards;
+
+    std::atomic<Shard*>& slot = shards_[shardIdx];
+    Shard* shard = slot.load(std::memory_order_acquire);
+    if (!shard) {
+        // Create the shard; if another thread was faster, use its shard
+        Shard* newShard = new Shard;
+        if (slot.compare_exchange_strong(shard, newShard, std::memory_order_acq_rel))
+            shard = newShard;
+        else
+            delete newShard;
+    }
+    return *shard;
+}
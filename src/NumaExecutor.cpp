@@ -0,0 +1,43 @@
+#include "tasks/NumaExecutor.hpp"
+
+NumaExecutor::NumaExecutor() {
+    std::vector<std::vector<int>> coreSets;
+    for (auto& node : discoverNumaTopology())
+        coreSets.push_back(std::move(node.cpus_));
+    createNodeExecutors(coreSets);
+}
+
+NumaExecutor::NumaExecutor(const std::vector<std::vector<int>>& coreSets) {
+    createNodeExecutors(coreSets);
+}
+
+void NumaExecutor::createNodeExecutors(const std::vector<std::vector<int>>& coreSets) {
+    if (coreSets.size() <= 1) {
+        // Single node: nothing to pin
+        int numThreads = coreSets.empty() ? 0 : int(coreSets[0].size());
+        nodeExecutors_.push_back(std::make_shared<WorkStealingExecutor>(numThreads));
+        return;
+    }
+    nodeExecutors_.reserve(coreSets.size());
+    for (const auto& cpus : coreSets)
+        nodeExecutors_.push_back(std::make_shared<WorkStealingExecutor>(int(cpus.size()), cpus));
+}
+
+bool NumaExecutor::isWorkerThread() const {
+    for (auto& executor : nodeExecutors_)
+        if (executor->isWorkerThread())
+            return true;
+    return false;
+}
+
+void NumaExecutor::enqueue(Task t, TaskPriority prio) {
+    // Keep the task on the current node, if we are running on one of our nodes
+    for (auto& executor : nodeExecutors_) {
+        if (executor->isWorkerThread()) {
+            executor->enqueue(std::move(t), prio);
+            return;
+        }
+    }
+    unsigned nodeIdx = nextNode_.fetch_add(1, std::memory_order_relaxed);
+    nodeExecutors_[nodeIdx % nodeExecutors_.size()]->enqueue(std::move(t), prio);
+}
@@ -0,0 +1,63 @@
+#include "tasks/NumaTopology.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#if defined(__linux__)
+#include <dirent.h>
+#endif
+
+std::vector<int> parseCpuList(const std::string& cpuList) {
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < cpuList.size()) {
+        std::size_t end = cpuList.find(',', pos);
+        if (end == std::string::npos)
+            end = cpuList.size();
+        std::string range = cpuList.substr(pos, end - pos);
+        pos = end + 1;
+
+        std::size_t dash = range.find('-');
+        if (range.empty() || range[0] < '0' || range[0] > '9')
+            continue;
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> discoverNumaTopology() {
+    std::vector<NumaNode> nodes;
+
+#if defined(__linux__)
+    const std::string nodesDir = "/sys/devices/system/node/";
+    if (DIR* dir = opendir(nodesDir.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                    name.find_first_not_of("0123456789", 4) != std::string::npos)
+                continue;
+
+            std::ifstream cpuListFile(nodesDir + name + "/cpulist");
+            std::string cpuList;
+            if (!std::getline(cpuListFile, cpuList))
+                continue;
+            // Ignore memory-only nodes
+            std::vector<int> cpus = parseCpuList(cpuList);
+            if (!cpus.empty())
+                nodes.push_back(NumaNode{std::atoi(name.c_str() + 4), std::move(cpus)});
+        }
+        closedir(dir);
+    }
+    std::sort(nodes.begin(), nodes.end(),
+            [](const NumaNode& lhs, const NumaNode& rhs) { return lhs.id_ < rhs.id_; });
+#endif
+
+    // If we couldn't determine the topology, assume a single node containing all the CPUs
+    if (nodes.empty())
+        nodes.push_back(NumaNode{0, {}});
+    return nodes;
+}
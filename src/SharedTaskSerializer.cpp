@@ -0,0 +1,119 @@
+#include "tasks/SharedTaskSerializer.hpp"
+#include "tasks/BlockPool.hpp"
+
+#include <thread>
+
+SharedTaskSerializer::SharedTaskSerializer(TaskExecutorPtr executor)
+    : baseExecutor_(std::move(executor)) {}
+
+SharedTaskSerializer::~SharedTaskSerializer() {
+    // The dispatched tasks refer to us; wait for them to complete
+    while (numDispatched_.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+    // Discard the tasks that were never executed
+    while (firstWaiting_) {
+        TaskNode* next = firstWaiting_->next_;
+        deletePooled(firstWaiting_);
+        firstWaiting_ = next;
+    }
+}
+
+void SharedTaskSerializer::enqueueRead(Task t, TaskPriority prio) {
+    add(newPooled<TaskNode>(std::move(t), prio, false));
+}
+
+void SharedTaskSerializer::enqueueWrite(Task t, TaskPriority prio) {
+    add(newPooled<TaskNode>(std::move(t), prio, true));
+}
+
+void SharedTaskSerializer::add(TaskNode* node) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A read joins the reads in execution, unless there are tasks waiting before it; a write
+        // can only start if nothing is in execution, and nothing is waiting
+        bool canStart = !writerActive_ && !firstWaiting_ &&
+                        (!node->isWrite_ || numActiveReaders_ == 0);
+        if (!canStart) {
+            if (lastWaiting_)
+                lastWaiting_->next_ = node;
+            else
+                firstWaiting_ = node;
+            lastWaiting_ = node;
+            return;
+        }
+        if (node->isWrite_)
+            writerActive_ = true;
+        else
+            numActiveReaders_++;
+    }
+    dispatch(node);
+}
+
+void SharedTaskSerializer::onTaskDone(bool wasWrite) {
+    TaskNode* admitted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (wasWrite)
+            writerActive_ = false;
+        else
+            numActiveReaders_--;
+        if (numActiveReaders_ == 0 && !writerActive_)
+            admitted = admitWaitingTasks();
+    }
+    dispatch(admitted);
+}
+
+SharedTaskSerializer::TaskNode* SharedTaskSerializer::admitWaitingTasks() {
+    TaskNode* first = firstWaiting_;
+    if (!first)
+        return nullptr;
+    if (first->isWrite_) {
+        // A write task is admitted alone
+        writerActive_ = true;
+        firstWaiting_ = first->next_;
+        first->next_ = nullptr;
+    } else {
+        // Admit all the consecutive reads, up to the next write
+        TaskNode* last = first;
+        numActiveReaders_++;
+        while (last->next_ && !last->next_->isWrite_) {
+            last = last->next_;
+            numActiveReaders_++;
+        }
+        firstWaiting_ = last->next_;
+        last->next_ = nullptr;
+    }
+    if (!firstWaiting_)
+        lastWaiting_ = nullptr;
+    return first;
+}
+
+void SharedTaskSerializer::dispatch(TaskNode* first) {
+    // Enqueue the tasks in batches, so that the base executor can enqueue them all at once
+    constexpr int maxBatchSize = 16;
+    Task batch[maxBatchSize];
+    while (first) {
+        TaskPriority prio = first->priority_;
+        int batchSize = 0;
+        while (first && first->priority_ == prio && batchSize < maxBatchSize) {
+            TaskNode* node = first;
+            first = first->next_;
+            node->next_ = nullptr;
+            batch[batchSize++] = [this, node] { this->execute(node); };
+        }
+        numDispatched_.fetch_add(batchSize, std::memory_order_relaxed);
+        if (batchSize == 1)
+            baseExecutor_->enqueue(std::move(batch[0]), prio);
+        else
+            baseExecutor_->enqueueBulk(batch, batch + batchSize, prio);
+    }
+}
+
+void SharedTaskSerializer::execute(TaskNode* node) {
+    bool isWrite = node->isWrite_;
+    node->task_();
+    deletePooled(node);
+    onTaskDone(isWrite);
+    // Must be the last access to the serializer; the destructor may complete right after it
+    numDispatched_.fetch_sub(1, std::memory_order_release);
+}
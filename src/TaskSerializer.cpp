@@ -1,34 +1,77 @@
 #include "tasks/TaskSerializer.hpp"
 
-TaskSerializer::TaskSerializer(TaskExecutorPtr executor)
-    : baseExecutor_(std::move(executor)) {}
+#include <cassert>
 
-void TaskSerializer::enqueue(Task t) {
-    // Add the task to our standby queue
-    standbyTasks_.emplace(std::move(t));
+constexpr int TaskSerializer::maxTasksPerHopLimit;
 
-    // If this the first task in our standby queue, start executing it
-    if (++count_ == 1)
-        enqueueFirst();
+TaskSerializer::TaskSerializer(TaskExecutorPtr executor, TaskSerializerOptions options)
+    : baseExecutor_(std::move(executor))
+    , core_(options) {}
+
+TaskSerializer::~TaskSerializer() { core_.waitForDrains(); }
+
+void TaskSerializer::enqueue(Task t, TaskPriority prio) {
+    if (core_.isBounded()) {
+        EnqueueStatus status = tryEnqueue(std::move(t), prio);
+        assert(status != EnqueueStatus::rejected && "use tryEnqueue() with the reject policy");
+        (void)status;
+        return;
+    }
+    // If the serializer was idle, start draining the queue
+    if (core_.push(std::move(t), prio))
+        startDrain(prio);
+}
+
+void TaskSerializer::enqueueBulk(Task* first, Task* last, TaskPriority prio) {
+    // Bounded serializers need to check the capacity for each task
+    if (core_.isBounded()) {
+        TaskExecutor::enqueueBulk(first, last, prio);
+        return;
+    }
+    if (core_.pushBulk(first, last, prio))
+        startDrain(prio);
+}
+
+EnqueueStatus TaskSerializer::tryEnqueue(Task t, TaskPriority prio, Task resume) {
+    if (!core_.isBounded()) {
+        enqueue(std::move(t), prio);
+        return EnqueueStatus::enqueued;
+    }
+    bool wasIdle = false;
+    EnqueueStatus status = core_.pushBounded(std::move(t), prio, std::move(resume), wasIdle);
+    if (wasIdle)
+        startDrain(prio);
+    return status;
+}
+
+void TaskSerializer::startDrain(TaskPriority prio) {
+    core_.beginDrain();
+    // If we are already on the base executor, we can avoid a round-trip through its queue
+    if (core_.canDrainInline(prio) && baseExecutor_->isWorkerThread() &&
+            TaskSerializerCore::enterInlineDrain()) {
+        drain();
+        TaskSerializerCore::exitInlineDrain();
+        return;
+    }
+    enqueueDrain(prio);
 }
 
-void TaskSerializer::enqueueFirst() {
-    // Get the task to execute
-    Task toExecute;
-    bool res = standbyTasks_.try_pop(toExecute);
-    assert(res);
-    // Enqueue the task
-    baseExecutor_->enqueue([this, t = std::move(toExecute)] {
-        // Execute current task
-        t();
-        // Check for continuation
-        this->onTaskDone();
-    });
+void TaskSerializer::enqueueDrain(TaskPriority prio) {
+    // Don't move the task into a new closure; just enqueue a small wrapper that will pick up the
+    // tasks from the queue when executed. This fits into the inline buffer of Task.
+    baseExecutor_->enqueue([this] { this->drain(); }, prio);
 }
 
-void TaskSerializer::onTaskDone() {
-    // If we still have tasks in our standby queue, enqueue the first one.
-    // One at a time.
-    if (--count_ != 0)
-        enqueueFirst();
+void TaskSerializer::drain() {
+    TaskPriority nextPrio;
+    bool hasMoreTasks = core_.drain(nextPrio);
+    // Resume the producers whose tasks got room in the serializer
+    Task resume;
+    while (core_.takeResumedProducer(resume))
+        baseExecutor_->enqueue(std::move(resume));
+    // The next drain hop takes over our mark; otherwise, this is the last access to our members
+    if (hasMoreTasks)
+        enqueueDrain(nextPrio);
+    else
+        core_.endDrain();
 }
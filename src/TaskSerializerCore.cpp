@@ -0,0 +1,304 @@
+#include "tasks/TaskSerializerCore.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+constexpr int TaskSerializerCore::maxTasksPerHopLimit;
+constexpr int TaskSerializerCore::maxInlineDepth;
+
+namespace {
+//! The number of drains running on the current thread, on behalf of the enqueuing tasks
+thread_local int inlineDrainDepth = 0;
+} // namespace
+
+//! The state of a bounded serializer
+struct TaskSerializerCore::BoundedState {
+    //! A task waiting for room in the serializer, together with the continuation of its producer
+    struct SuspendedTask {
+        Task task_;
+        TaskPriority priority_;
+        Task resume_;
+        SuspendedTask* next_{nullptr};
+
+        SuspendedTask(Task t, TaskPriority prio, Task resume)
+            : task_(std::move(t))
+            , priority_(prio)
+            , resume_(std::move(resume)) {}
+    };
+    //! A list of suspended tasks, in FIFO order
+    struct SuspendedList {
+        SuspendedTask* first_{nullptr};
+        SuspendedTask* last_{nullptr};
+
+        void pushBack(SuspendedTask* node) {
+            node->next_ = nullptr;
+            if (last_)
+                last_->next_ = node;
+            else
+                first_ = node;
+            last_ = node;
+        }
+        SuspendedTask* popFront() {
+            SuspendedTask* node = first_;
+            if (node) {
+                first_ = node->next_;
+                if (!first_)
+                    last_ = nullptr;
+            }
+            return node;
+        }
+        void clear() {
+            while (auto node = popFront())
+                deletePooled(node);
+        }
+    };
+
+    std::size_t capacity_;
+    OverflowPolicy overflowPolicy_;
+    //! The number of tasks in the serializer, waiting or in execution
+    std::atomic<std::size_t> depth_{0};
+    //! Protects the lists below. With the suspend policy, the places of the completed tasks are
+    //! released under this mutex, so that no suspended task can miss them.
+    std::mutex mutex_;
+    //! The tasks waiting for room in the serializer
+    SuspendedList suspended_;
+    //! The tasks that entered the serializer, whose producers still need to be resumed
+    SuspendedList resumed_;
+    //! The size of resumed_; allows checking for producers to resume without locking
+    std::atomic<int> numResumed_{0};
+
+    BoundedState(std::size_t capacity, OverflowPolicy policy)
+        : capacity_(capacity)
+        , overflowPolicy_(policy) {}
+    ~BoundedState() {
+        suspended_.clear();
+        resumed_.clear();
+    }
+};
+
+TaskSerializerCore::TaskSerializerCore(TaskSerializerOptions options)
+    : maxTasksPerHop_(std::min(std::max(options.maxTasksPerHop, 1), maxTasksPerHopLimit))
+    , timeBudget_(options.timeBudget)
+    , tryRunInline_(options.tryRunInline) {
+    if (options.capacity > 0)
+        bounded_.reset(new BoundedState(options.capacity, options.overflowPolicy));
+}
+
+TaskSerializerCore::~TaskSerializerCore() {
+    // Discard the tasks that were never executed
+    fetchPendingTasks();
+    while (auto node = popPendingTask())
+        deletePooled(node);
+}
+
+bool TaskSerializerCore::push(Task t, TaskPriority prio) {
+    // Add the task to our standby queue; report if the serializer was idle
+#if TASKS_INSTRUMENTATION
+    counters_.onEnqueue();
+#endif
+    bool wasIdle = standbyTasks_.push(newPooled<TaskNode>(std::move(t), prio));
+#if TASKS_INSTRUMENTATION
+    if (!wasIdle)
+        counters_.onFoundBusy();
+#endif
+    return wasIdle;
+}
+
+bool TaskSerializerCore::pushBulk(Task* first, Task* last, TaskPriority prio) {
+    if (first == last)
+        return false;
+    // Link the nodes together before adding them to the standby queue, with a single operation
+    TaskNode* firstNode = newPooled<TaskNode>(std::move(*first), prio);
+    TaskNode* lastNode = firstNode;
+    for (++first; first != last; ++first) {
+        TaskNode* node = newPooled<TaskNode>(std::move(*first), prio);
+        lastNode->next_.store(node, std::memory_order_relaxed);
+        lastNode = node;
+    }
+#if TASKS_INSTRUMENTATION
+    for (MpscNode* node = firstNode; node; node = node->next_.load(std::memory_order_relaxed))
+        counters_.onEnqueue();
+#endif
+    bool wasIdle = standbyTasks_.pushChain(firstNode, lastNode);
+#if TASKS_INSTRUMENTATION
+    if (!wasIdle)
+        counters_.onFoundBusy();
+#endif
+    return wasIdle;
+}
+
+EnqueueStatus TaskSerializerCore::pushBounded(
+        Task t, TaskPriority prio, Task resume, bool& wasIdle) {
+    wasIdle = false;
+    if (!tryReserveSlot()) {
+        switch (bounded_->overflowPolicy_) {
+        case OverflowPolicy::reject:
+            return EnqueueStatus::rejected;
+        case OverflowPolicy::runInline:
+            t();
+            return EnqueueStatus::ranInline;
+        case OverflowPolicy::suspend: {
+            std::lock_guard<std::mutex> lock(bounded_->mutex_);
+            // Check again, as a task might have completed meanwhile
+            if (tryReserveSlot())
+                break;
+            bounded_->suspended_.pushBack(newPooled<BoundedState::SuspendedTask>(
+                    std::move(t), prio, std::move(resume)));
+            return EnqueueStatus::suspended;
+        }
+        }
+    }
+    wasIdle = push(std::move(t), prio);
+    return EnqueueStatus::enqueued;
+}
+
+bool TaskSerializerCore::takeResumedProducer(Task& resume) {
+    if (!bounded_ || bounded_->numResumed_.load(std::memory_order_acquire) == 0)
+        return false;
+    BoundedState::SuspendedTask* node;
+    {
+        std::lock_guard<std::mutex> lock(bounded_->mutex_);
+        node = bounded_->resumed_.popFront();
+        if (!node)
+            return false;
+        bounded_->numResumed_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    resume = std::move(node->resume_);
+    deletePooled(node);
+    return true;
+}
+
+bool TaskSerializerCore::enterInlineDrain() {
+    if (inlineDrainDepth >= maxInlineDepth)
+        return false;
+    inlineDrainDepth++;
+    return true;
+}
+
+void TaskSerializerCore::exitInlineDrain() { inlineDrainDepth--; }
+
+void TaskSerializerCore::waitForDrains() const {
+    while (numActiveDrains_.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+}
+
+std::size_t TaskSerializerCore::depth() const {
+    return bounded_ ? bounded_->depth_.load(std::memory_order_relaxed) : 0;
+}
+
+bool TaskSerializerCore::drain(TaskPriority& nextPrio) {
+    using Clock = std::chrono::steady_clock;
+    const bool hasBudget = timeBudget_.count() > 0;
+    const auto deadline = hasBudget ? Clock::now() + timeBudget_ : Clock::time_point{};
+
+    int numExecuted = 0;
+    while (true) {
+        // Get the task to execute; the one with the highest priority
+        fetchPendingTasks();
+        TaskNode* node = popPendingTask();
+        if (!node) {
+            // If there are no more tasks in our standby queue, we are done
+            if (standbyTasks_.tryMarkIdle())
+                return false;
+            // A producer is in the middle of adding a task; wait for it
+            std::this_thread::yield();
+            continue;
+        }
+        // Execute current task
+#if TASKS_INSTRUMENTATION
+        auto startTimeNs = counters_.onStart(node->enqueueTimeNs_);
+        node->task_();
+        counters_.onEnd(startTimeNs);
+#else
+        node->task_();
+#endif
+        deletePooled(node);
+        if (bounded_)
+            releaseSlot();
+
+        // If we exhausted the limits of this hop, yield to the other tasks of the base executor,
+        // and continue later (if we still have tasks)
+        if (++numExecuted >= maxTasksPerHop_ || (hasBudget && Clock::now() >= deadline)) {
+            fetchPendingTasks();
+            if (hasPendingTasks() || !standbyTasks_.tryMarkIdle()) {
+                nextPrio = topPendingPriority();
+                return true;
+            }
+            return false;
+        }
+    }
+}
+
+void TaskSerializerCore::fetchPendingTasks() {
+    while (auto node = static_cast<TaskNode*>(standbyTasks_.pop())) {
+        PendingList& list = pendingTasks_[int(node->priority_)];
+        node->nextPending_ = nullptr;
+        if (list.last_)
+            list.last_->nextPending_ = node;
+        else
+            list.first_ = node;
+        list.last_ = node;
+    }
+}
+
+TaskSerializerCore::TaskNode* TaskSerializerCore::popPendingTask() {
+    for (int p = numTaskPriorities - 1; p >= 0; p--) {
+        PendingList& list = pendingTasks_[p];
+        if (TaskNode* node = list.first_) {
+            list.first_ = node->nextPending_;
+            if (!list.first_)
+                list.last_ = nullptr;
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+bool TaskSerializerCore::hasPendingTasks() const {
+    for (const auto& list : pendingTasks_)
+        if (list.first_)
+            return true;
+    return false;
+}
+
+TaskPriority TaskSerializerCore::topPendingPriority() const {
+    for (int p = numTaskPriorities - 1; p >= 0; p--)
+        if (pendingTasks_[p].first_)
+            return TaskPriority(p);
+    return TaskPriority::normal;
+}
+
+bool TaskSerializerCore::tryReserveSlot() {
+    std::size_t depth = bounded_->depth_.load(std::memory_order_relaxed);
+    while (depth < bounded_->capacity_) {
+        if (bounded_->depth_.compare_exchange_weak(depth, depth + 1, std::memory_order_acquire))
+            return true;
+    }
+    return false;
+}
+
+void TaskSerializerCore::releaseSlot() {
+    if (bounded_->overflowPolicy_ != OverflowPolicy::suspend) {
+        bounded_->depth_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    BoundedState::SuspendedTask* node;
+    {
+        std::lock_guard<std::mutex> lock(bounded_->mutex_);
+        node = bounded_->suspended_.popFront();
+        if (!node) {
+            bounded_->depth_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        // The suspended task takes the place of the completed one. We are in the middle of
+        // draining, so the push cannot find the serializer idle.
+        push(std::move(node->task_), node->priority_);
+        if (node->resume_) {
+            bounded_->resumed_.pushBack(node);
+            bounded_->numResumed_.fetch_add(1, std::memory_order_release);
+            node = nullptr;
+        }
+    }
+    deletePooled(node);
+}
@@ -0,0 +1,171 @@
+#include "tasks/TimerExecutor.hpp"
+
+#include <algorithm>
+
+constexpr int TimerExecutor::slotBits;
+constexpr int TimerExecutor::numSlots;
+constexpr int TimerExecutor::numLevels;
+
+TimerExecutor::TimerExecutor(TaskExecutorPtr executor, Clock::duration tickDuration)
+    : targetExecutor_(std::move(executor))
+    , tickDuration_(tickDuration.count() > 0 ? tickDuration : Clock::duration(1))
+    , startTime_(Clock::now()) {
+    timerThread_ = std::thread([this] { run(); });
+}
+
+TimerExecutor::~TimerExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_one();
+    timerThread_.join();
+
+    // Discard the tasks that were never dispatched
+    while (auto node = static_cast<TimerNode*>(newTimers_.pop()))
+        delete node;
+    for (auto& level : wheel_) {
+        for (auto& slot : level) {
+            while (TimerNode* node = slot) {
+                slot = node->nextInSlot_;
+                delete node;
+            }
+        }
+    }
+}
+
+void TimerExecutor::enqueue(Task t, TaskPriority prio) {
+    targetExecutor_->enqueue(std::move(t), prio);
+}
+
+void TimerExecutor::enqueueBulk(Task* first, Task* last, TaskPriority prio) {
+    targetExecutor_->enqueueBulk(first, last, prio);
+}
+
+bool TimerExecutor::isWorkerThread() const { return targetExecutor_->isWorkerThread(); }
+
+void TimerExecutor::enqueueAt(Clock::time_point time, Task t, TaskPriority prio) {
+    if (time <= Clock::now()) {
+        targetExecutor_->enqueue(std::move(t), prio);
+        return;
+    }
+    // If the timer thread is waiting without any timers, wake it up
+    if (newTimers_.push(new TimerNode(std::move(t), prio, tickFor(time)))) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeUp_ = true;
+        }
+        cond_.notify_one();
+    }
+}
+
+void TimerExecutor::run() {
+    // The queue of new timers starts as idle; the first push will wake us up
+    bool idle = true;
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (idle) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return wakeUp_ || stopping_; });
+            wakeUp_ = false;
+            idle = false;
+            continue;
+        }
+        if (numTimers_ == 0) {
+            // Nothing in the wheel; we can jump directly to the current time
+            currentTick_ = std::max(currentTick_, elapsedTicks());
+            fetchNewTimers();
+            if (numTimers_ == 0) {
+                // Still nothing to do; go idle, unless a push is in progress
+                idle = newTimers_.tryMarkIdle();
+                continue;
+            }
+        }
+
+        // Wait for the next tick, then dispatch all the tasks that expired in the meantime
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_until(lock, startTime_ + tickDuration_ * std::int64_t(currentTick_ + 1),
+                    [this] { return stopping_.load(); });
+        }
+        fetchNewTimers();
+        std::uint64_t nowTick = elapsedTicks();
+        while (currentTick_ < nowTick && numTimers_ > 0)
+            advanceTick();
+    }
+}
+
+void TimerExecutor::fetchNewTimers() {
+    while (auto node = static_cast<TimerNode*>(newTimers_.pop())) {
+        if (node->expiryTick_ <= currentTick_)
+            dispatch(node);
+        else {
+            insert(node);
+            numTimers_++;
+        }
+    }
+}
+
+void TimerExecutor::insert(TimerNode* node) {
+    std::uint64_t delta = node->expiryTick_ - currentTick_;
+    int level = 0;
+    while (level < numLevels - 1 && delta >= (std::uint64_t(1) << (slotBits * (level + 1))))
+        level++;
+    // Delays too long for the wheel are placed in the last slot they can reach; they are
+    // re-inserted with their real expiry tick when that slot is cascaded
+    std::uint64_t tick = node->expiryTick_;
+    std::uint64_t maxDelta = (std::uint64_t(1) << (slotBits * numLevels)) - 1;
+    if (delta > maxDelta)
+        tick = currentTick_ + maxDelta;
+    int slot = int((tick >> (slotBits * level)) & (numSlots - 1));
+    node->nextInSlot_ = wheel_[level][slot];
+    wheel_[level][slot] = node;
+}
+
+void TimerExecutor::advanceTick() {
+    currentTick_++;
+
+    // When a level wraps around, bring down the timers from the corresponding slot of the next
+    // level; the higher levels are cascaded first
+    int level = 1;
+    while (level < numLevels &&
+            (currentTick_ & ((std::uint64_t(1) << (slotBits * level)) - 1)) == 0)
+        level++;
+    for (level = level - 1; level > 0; level--)
+        cascade(level, int((currentTick_ >> (slotBits * level)) & (numSlots - 1)));
+
+    // Dispatch the tasks that expire at the current tick
+    TimerNode*& slot = wheel_[0][currentTick_ & (numSlots - 1)];
+    TimerNode* node = slot;
+    slot = nullptr;
+    while (node) {
+        TimerNode* next = node->nextInSlot_;
+        numTimers_--;
+        dispatch(node);
+        node = next;
+    }
+}
+
+void TimerExecutor::cascade(int level, int slot) {
+    TimerNode* node = wheel_[level][slot];
+    wheel_[level][slot] = nullptr;
+    while (node) {
+        TimerNode* next = node->nextInSlot_;
+        insert(node);
+        node = next;
+    }
+}
+
+void TimerExecutor::dispatch(TimerNode* node) {
+    targetExecutor_->enqueue(std::move(node->task_), node->priority_);
+    delete node;
+}
+
+std::uint64_t TimerExecutor::elapsedTicks() const {
+    return std::uint64_t((Clock::now() - startTime_) / tickDuration_);
+}
+
+std::uint64_t TimerExecutor::tickFor(Clock::time_point time) const {
+    if (time <= startTime_)
+        return 0;
+    return std::uint64_t((time - startTime_ + tickDuration_ - Clock::duration(1)) / tickDuration_);
+}
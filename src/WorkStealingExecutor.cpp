@@ -0,0 +1,246 @@
+#include "tasks/WorkStealingExecutor.hpp"
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+//! Data corresponding to one worker thread
+struct WorkStealingExecutor::Worker {
+    //! The executor this worker belongs to
+    WorkStealingExecutor* owner_;
+    //! The index of the worker in the executor
+    int index_;
+    //! The tasks enqueued from this worker
+    ChaseLevDeque<Task*> tasks_;
+    //! State of the random generator used to pick victims for stealing
+    unsigned rngState_;
+    //! The number of tasks executed, used to check the injection queue from time to time
+    unsigned numExecuted_{0};
+    //! The thread of the worker
+    std::thread thread_;
+
+    Worker(WorkStealingExecutor* owner, int index)
+        : owner_(owner)
+        , index_(index)
+        , rngState_(2654435761u * unsigned(index + 1)) {}
+
+    //! Xorshift random generator
+    unsigned nextRandom() {
+        rngState_ ^= rngState_ << 13;
+        rngState_ ^= rngState_ >> 17;
+        rngState_ ^= rngState_ << 5;
+        return rngState_;
+    }
+};
+
+thread_local WorkStealingExecutor::Worker* WorkStealingExecutor::currentWorker_ = nullptr;
+
+namespace {
+//! The number of times a worker looks for tasks before going to sleep
+constexpr int numSpinsBeforeSleep = 64;
+//! A worker will check the injection queue before its own deque every this many tasks, so that
+//! tasks from external threads are not starved by long chains of continuations
+constexpr unsigned injectionCheckInterval = 61;
+//! A worker will take the oldest task of its own deque, instead of the newest, every this many
+//! tasks. Otherwise, a task that keeps enqueueing a new task (e.g., a retry loop) would keep the
+//! older tasks at the bottom of the deque from ever running.
+constexpr unsigned oldestTaskInterval = 8;
+
+//! Restricts the given thread to run only on the given CPUs. Does nothing if not supported.
+void pinThread(std::thread& thread, const std::vector<int>& cpus) {
+#if defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuSet);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+    (void)thread;
+    (void)cpus;
+#endif
+}
+} // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(int numThreads)
+    : WorkStealingExecutor(numThreads, {}) {}
+
+WorkStealingExecutor::WorkStealingExecutor(int numThreads, std::vector<int> cpus) {
+    if (numThreads <= 0 && !cpus.empty())
+        numThreads = int(cpus.size());
+    if (numThreads <= 0)
+        numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+    workers_.reserve(numThreads);
+    for (int i = 0; i < numThreads; i++)
+        workers_.emplace_back(new Worker(this, i));
+    // Start the threads only after all the workers are created, as they might steal from each other
+    for (auto& w : workers_) {
+        Worker* worker = w.get();
+        worker->thread_ = std::thread([this, worker] { this->workerLoop(*worker); });
+        if (!cpus.empty())
+            pinThread(worker->thread_, cpus);
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_.store(true);
+    }
+    wakeUpCond_.notify_all();
+    for (auto& w : workers_)
+        w->thread_.join();
+}
+
+void WorkStealingExecutor::enqueue(Task t, TaskPriority prio) {
+    auto task = newPooled<Task>(std::move(t));
+    if (prio != TaskPriority::low && isWorkerThread()) {
+        // Enqueued from one of our workers; keep it local, it will be the next task to execute
+        currentWorker_->tasks_.push(task);
+    } else {
+        // Low priority tasks go to the back of the injection queue, even if enqueued from a
+        // worker, so they don't delay the continuations. High priority tasks from external
+        // threads go to the front.
+        std::lock_guard<std::mutex> lock(injectionMutex_);
+        if (prio == TaskPriority::high)
+            injectionQueue_.push_front(task);
+        else
+            injectionQueue_.push_back(task);
+        injectionSize_.fetch_add(1, std::memory_order_release);
+    }
+    notifyWorkers();
+}
+
+void WorkStealingExecutor::enqueueBulk(Task* first, Task* last, TaskPriority prio) {
+    if (first == last)
+        return;
+    std::size_t numTasks = std::size_t(last - first);
+    if (prio != TaskPriority::low && isWorkerThread()) {
+        for (; first != last; ++first)
+            currentWorker_->tasks_.push(newPooled<Task>(std::move(*first)));
+    } else {
+        std::lock_guard<std::mutex> lock(injectionMutex_);
+        if (prio == TaskPriority::high) {
+            // Keep the order of the tasks at the front of the queue
+            for (Task* it = last; it != first; --it)
+                injectionQueue_.push_front(newPooled<Task>(std::move(*(it - 1))));
+        } else {
+            for (; first != last; ++first)
+                injectionQueue_.push_back(newPooled<Task>(std::move(*first)));
+        }
+        injectionSize_.fetch_add(numTasks, std::memory_order_release);
+    }
+    notifyWorkers(numTasks);
+}
+
+bool WorkStealingExecutor::isWorkerThread() const {
+    return currentWorker_ && currentWorker_->owner_ == this;
+}
+
+void WorkStealingExecutor::workerLoop(Worker& worker) {
+    currentWorker_ = &worker;
+    int numIdleSpins = 0;
+    while (true) {
+        Task* task = findTask(worker);
+        if (task) {
+            numIdleSpins = 0;
+            (*task)();
+            deletePooled(task);
+            continue;
+        }
+
+        if (stopping_.load()) {
+            if (!hasTasks())
+                break;
+            continue;
+        }
+
+        // Spin for a while before going to sleep; new tasks may come soon
+        if (++numIdleSpins < numSpinsBeforeSleep) {
+            std::this_thread::yield();
+            continue;
+        }
+        numIdleSpins = 0;
+
+        // Go to sleep, until new tasks are enqueued
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        numSleeping_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!stopping_.load() && !hasTasks())
+            wakeUpCond_.wait(lock);
+        numSleeping_.fetch_sub(1);
+    }
+    currentWorker_ = nullptr;
+}
+
+Task* WorkStealingExecutor::findTask(Worker& worker) {
+    Task* task = nullptr;
+    // From time to time, prefer the tasks from external threads
+    if (++worker.numExecuted_ % injectionCheckInterval == 0)
+        task = popInjected();
+    // From time to time, take the oldest task we enqueued, so that it's not starved
+    if (!task && worker.numExecuted_ % oldestTaskInterval == 0)
+        task = worker.tasks_.steal();
+    // Take the most recent task we enqueued
+    if (!task)
+        task = worker.tasks_.pop();
+    if (!task)
+        task = popInjected();
+    if (!task)
+        task = steal(worker);
+    return task;
+}
+
+Task* WorkStealingExecutor::popInjected() {
+    if (injectionSize_.load(std::memory_order_acquire) == 0)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(injectionMutex_);
+    if (injectionQueue_.empty())
+        return nullptr;
+    Task* task = injectionQueue_.front();
+    injectionQueue_.pop_front();
+    injectionSize_.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+Task* WorkStealingExecutor::steal(Worker& thief) {
+    int numWorkers = int(workers_.size());
+    if (numWorkers < 2)
+        return nullptr;
+    int start = int(thief.nextRandom() % unsigned(numWorkers));
+    for (int i = 0; i < numWorkers; i++) {
+        Worker& victim = *workers_[(start + i) % numWorkers];
+        if (&victim == &thief)
+            continue;
+        if (Task* task = victim.tasks_.steal())
+            return task;
+    }
+    return nullptr;
+}
+
+bool WorkStealingExecutor::hasTasks() const {
+    if (injectionSize_.load(std::memory_order_acquire) != 0)
+        return true;
+    for (const auto& w : workers_)
+        if (!w->tasks_.empty())
+            return true;
+    return false;
+}
+
+void WorkStealingExecutor::notifyWorkers(std::size_t numTasks) {
+    // Pairs with the fence in workerLoop: either the sleeping worker sees the new task, or we see
+    // the sleeping worker
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int numSleeping = numSleeping_.load(std::memory_order_relaxed);
+    if (numSleeping > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        if (numTasks >= std::size_t(numSleeping))
+            wakeUpCond_.notify_all();
+        else
+            for (std::size_t i = 0; i < numTasks; i++)
+                wakeUpCond_.notify_one();
+    }
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+//! A block that is not in use; while free, the block stores the link to the next free block
+struct FreeBlock {
+    FreeBlock* next_;
+};
+
+//! The number of system allocations made by all the block pools
+inline std::atomic<std::uint64_t>& blockPoolSystemAllocations() {
+    static std::atomic<std::uint64_t> counter{0};
+    return counter;
+}
+
+} // namespace detail
+
+//! Returns the number of times the block pools allocated memory from the system, for all the block
+//! sizes. Once the pools are warmed up, this doesn't change anymore.
+inline std::uint64_t numBlockPoolSystemAllocations() {
+    return detail::blockPoolSystemAllocations().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief      Pool of memory blocks of a given size, with a free list per thread.
+ *
+ * Allocating and deallocating blocks only touches the free list of the current thread. Blocks can
+ * be deallocated on a different thread than the one that allocated them; the blocks accumulate in
+ * the free list of the deallocating thread, and are handed back to a shared depot in batches, from
+ * where the allocating threads take them, again in batches. Only when the depot is empty, a new
+ * slab of blocks is allocated from the system.
+ *
+ * The memory is never returned to the system; the pool keeps as many blocks as were in use at the
+ * peak.
+ *
+ * @tparam     blockSize  The size of the blocks; a multiple of the maximum alignment
+ */
+template <std::size_t blockSize>
+class BlockPool {
+    static_assert(blockSize >= sizeof(detail::FreeBlock), "blocks must be able to hold a link");
+    static_assert(blockSize % alignof(std::max_align_t) == 0, "blocks must keep the alignment");
+
+public:
+    //! The number of blocks moved between a thread and the depot at once
+    static constexpr std::size_t batchSize = 64;
+
+    //! Allocates a block
+    static void* allocate() {
+        ThreadCache& cache = threadCache();
+        if (!cache.free_)
+            refill(cache);
+        detail::FreeBlock* block = cache.free_;
+        cache.free_ = block->next_;
+        cache.count_--;
+        return block;
+    }
+
+    //! Deallocates a block obtained with allocate(), possibly on a different thread
+    static void deallocate(void* p) {
+        auto block = static_cast<detail::FreeBlock*>(p);
+        ThreadCache& cache = threadCache();
+        if (cache.finished_) {
+            // The thread is exiting; don't keep the block locally
+            block->next_ = nullptr;
+            depot().putBatch(block, 1);
+            return;
+        }
+        // The thread may never allocate; it still needs to hand back its blocks when it exits
+        if (!cache.registered_)
+            registerReleaser(cache);
+        block->next_ = cache.free_;
+        cache.free_ = block;
+        if (++cache.count_ >= 2 * batchSize)
+            flushBatch(cache);
+    }
+
+    //! Returns the number of slabs this pool allocated from the system
+    static std::uint64_t numSlabs() { return depot().numSlabs_.load(std::memory_order_relaxed); }
+
+private:
+    //! The free blocks of a thread. Trivially destructible, so that accessing it is cheap;
+    //! the blocks are handed back to the depot by a CacheReleaser, when the thread exits.
+    struct ThreadCache {
+        detail::FreeBlock* free_;
+        std::size_t count_;
+        //! True if a CacheReleaser was created for this thread
+        bool registered_;
+        //! True if the thread is exiting, and the cache was already released
+        bool finished_;
+    };
+
+    //! Hands back the blocks of the thread to the depot when the thread exits
+    struct CacheReleaser {
+        ~CacheReleaser() {
+            ThreadCache& cache = threadCache();
+            if (cache.free_)
+                depot().putBatch(cache.free_, cache.count_);
+            cache.free_ = nullptr;
+            cache.count_ = 0;
+            cache.finished_ = true;
+        }
+    };
+
+    //! The blocks shared by all the threads, in batches
+    struct Depot {
+        struct Batch {
+            detail::FreeBlock* first_;
+            std::size_t count_;
+        };
+        std::mutex mutex_;
+        std::vector<Batch> batches_;
+        std::atomic<std::uint64_t> numSlabs_{0};
+
+        void putBatch(detail::FreeBlock* first, std::size_t count) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(Batch{first, count});
+        }
+        bool takeBatch(Batch& batch) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (batches_.empty())
+                return false;
+            batch = batches_.back();
+            batches_.pop_back();
+            return true;
+        }
+    };
+
+    static ThreadCache& threadCache() {
+        static thread_local ThreadCache cache{nullptr, 0, false, false};
+        return cache;
+    }
+    static Depot& depot() {
+        // Never destroyed, as threads can still release blocks after the static destructors run
+        static Depot* depot = new Depot;
+        return *depot;
+    }
+
+    //! Creates the CacheReleaser of the thread, the first time the thread gets blocks in its cache
+    static void registerReleaser(ThreadCache& cache) {
+        static thread_local CacheReleaser releaser;
+        (void)releaser;
+        cache.registered_ = true;
+    }
+
+    //! Fills the free list of the thread with a batch from the depot, or with a new slab
+    static void refill(ThreadCache& cache) {
+        if (!cache.registered_ && !cache.finished_)
+            registerReleaser(cache);
+        typename Depot::Batch batch;
+        if (!depot().takeBatch(batch)) {
+            auto slab = static_cast<unsigned char*>(::operator new(blockSize * batchSize));
+            detail::blockPoolSystemAllocations().fetch_add(1, std::memory_order_relaxed);
+            depot().numSlabs_.fetch_add(1, std::memory_order_relaxed);
+            for (std::size_t i = 0; i < batchSize; i++) {
+                auto block = reinterpret_cast<detail::FreeBlock*>(slab + i * blockSize);
+                block->next_ = i + 1 < batchSize
+                                       ? reinterpret_cast<detail::FreeBlock*>(
+                                                 slab + (i + 1) * blockSize)
+                                       : nullptr;
+            }
+            batch = typename Depot::Batch{reinterpret_cast<detail::FreeBlock*>(slab), batchSize};
+        }
+        cache.free_ = batch.first_;
+        cache.count_ = batch.count_;
+    }
+
+    //! Moves one batch of blocks from the free list of the thread to the depot
+    static void flushBatch(ThreadCache& cache) {
+        detail::FreeBlock* first = cache.free_;
+        detail::FreeBlock* last = first;
+        for (std::size_t i = 1; i < batchSize; i++)
+            last = last->next_;
+        cache.free_ = last->next_;
+        cache.count_ -= batchSize;
+        last->next_ = nullptr;
+        depot().putBatch(first, batchSize);
+    }
+};
+
+template <std::size_t blockSize>
+constexpr std::size_t BlockPool<blockSize>::batchSize;
+
+//! The size of the largest objects allocated from block pools
+constexpr std::size_t maxPooledObjectSize = 256;
+
+//! Returns the size of the pool blocks used to hold objects of the given size
+constexpr std::size_t poolBlockSize(std::size_t objectSize) {
+    return (objectSize + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+           alignof(std::max_align_t);
+}
+
+//! Indicates whether objects of type T are allocated from block pools
+template <typename T>
+using isPoolable = std::integral_constant<bool,
+        sizeof(T) <= maxPooledObjectSize && alignof(T) <= alignof(std::max_align_t)>;
+
+namespace detail {
+template <typename T>
+void* allocateFor(std::true_type /*isPoolable*/) {
+    return BlockPool<poolBlockSize(sizeof(T))>::allocate();
+}
+template <typename T>
+void* allocateFor(std::false_type /*isPoolable*/) {
+    return ::operator new(sizeof(T));
+}
+template <typename T>
+void deallocateFor(void* p, std::true_type /*isPoolable*/) {
+    BlockPool<poolBlockSize(sizeof(T))>::deallocate(p);
+}
+template <typename T>
+void deallocateFor(void* p, std::false_type /*isPoolable*/) {
+    ::operator delete(p);
+}
+} // namespace detail
+
+//! Creates an object of type T; small objects are allocated from the block pools
+template <typename T, typename... Args>
+T* newPooled(Args&&... args) {
+    void* p = detail::allocateFor<T>(isPoolable<T>{});
+    try {
+        return new (p) T(std::forward<Args>(args)...);
+    } catch (...) {
+        detail::deallocateFor<T>(p, isPoolable<T>{});
+        throw;
+    }
+}
+
+//! Destroys an object created with newPooled()
+template <typename T>
+void deletePooled(T* obj) {
+    if (obj) {
+        obj->~T();
+        detail::deallocateFor<T>(obj, isPoolable<T>{});
+    }
+}
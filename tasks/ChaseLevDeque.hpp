@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief      Chase-Lev work-stealing deque.
+ *
+ * The owner thread pushes and pops items at the bottom of the deque (LIFO order), while any other
+ * thread can steal items from the top of the deque (FIFO order). The deque grows as needed; the
+ * arrays that are replaced are kept alive until the deque is destroyed, as thieves might still read
+ * from them.
+ *
+ * Implementation follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê, Pop,
+ * Cohen, Zappa Nardelli, PPoPP 2013).
+ *
+ * @tparam     T     The type of the items; must be a pointer type (null means "no item")
+ */
+template <typename T>
+class ChaseLevDeque {
+    static_assert(std::is_pointer<T>::value, "ChaseLevDeque can only hold pointers");
+
+public:
+    explicit ChaseLevDeque(std::size_t initialCapacity = 256)
+        : top_(0)
+        , bottom_(0) {
+        std::size_t capacity = 1;
+        while (capacity < initialCapacity)
+            capacity *= 2;
+        arrays_.emplace_back(new Array(capacity));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    //! Adds an item at the bottom of the deque. Must be called only by the owner.
+    void push(T item) {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > std::int64_t(a->capacity_) - 1) {
+            a = grow(a, t, b);
+            array_.store(a, std::memory_order_release);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    //! Takes the item from the bottom of the deque (the last one pushed).
+    //! Must be called only by the owner. Returns null if the deque is empty.
+    T pop() {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            // Empty deque
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = a->get(b);
+        if (t == b) {
+            // Last item; compete with the thieves for it
+            if (!top_.compare_exchange_strong(
+                        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    //! Takes the item from the top of the deque (the oldest one).
+    //! Can be called from any thread. Returns null if the deque is empty or if we lost a race.
+    T steal() {
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        Array* a = array_.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!top_.compare_exchange_strong(
+                    t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return item;
+    }
+
+    //! Checks if the deque seems empty; the result may be outdated by the time it's used
+    bool empty() const {
+        std::int64_t b = bottom_.load(std::memory_order_acquire);
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        return t >= b;
+    }
+
+private:
+    //! Circular array holding the items of the deque
+    struct Array {
+        std::size_t capacity_;
+        std::unique_ptr<std::atomic<T>[]> items_;
+
+        explicit Array(std::size_t capacity)
+            : capacity_(capacity)
+            , items_(new std::atomic<T>[capacity]) {}
+
+        T get(std::int64_t i) const {
+            return items_[std::size_t(i) & (capacity_ - 1)].load(std::memory_order_relaxed);
+        }
+        void put(std::int64_t i, T item) {
+            items_[std::size_t(i) & (capacity_ - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    //! Index of the oldest item; incremented by thieves
+    std::atomic<std::int64_t> top_;
+    //! Keeps the thieves' end and the owner's end on different cache lines
+    char padding_[64 - sizeof(std::atomic<std::int64_t>)];
+    //! Index after the newest item; only changed by the owner
+    std::atomic<std::int64_t> bottom_;
+    //! The array currently in use
+    std::atomic<Array*> array_;
+    //! All the arrays ever used by this deque; only accessed by the owner
+    std::vector<std::unique_ptr<Array>> arrays_;
+
+    //! Creates an array twice as big, copying the items in the range [t, b)
+    Array* grow(Array* a, std::int64_t t, std::int64_t b) {
+        Array* newArray = new Array(a->capacity_ * 2);
+        for (std::int64_t i = t; i < b; i++)
+            newArray->put(i, a->get(i));
+        arrays_.emplace_back(newArray);
+        return newArray;
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+// Coroutine support; needs C++20. Enable it with the TASKS_ENABLE_COROUTINES CMake option, which
+// defines TASKS_HAS_COROUTINES; otherwise, it is defined here if the compiler supports coroutines.
+// Code depending on the coroutine support checks TASKS_HAS_COROUTINES, after including this file.
+#if !defined(TASKS_HAS_COROUTINES) && defined(__cpp_impl_coroutine) && \
+        __cpp_impl_coroutine >= 201902L
+#define TASKS_HAS_COROUTINES 1
+#endif
+
+#if TASKS_HAS_COROUTINES
+
+#include "TaskExecutor.hpp"
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+/**
+ * @brief      Allocator for coroutine frames that recycles the freed frames.
+ *
+ * Keeps thread-local free lists of frames, bucketed by size. A frame freed on a different thread
+ * than the one that allocated it just goes into the free list of the freeing thread. Frames that
+ * are too big, or that would make the free lists too long, go back to the global allocator.
+ */
+class CoroutineFrameAllocator {
+public:
+    static void* allocate(std::size_t size) {
+        std::size_t bucket = bucketFor(size);
+        if (bucket < numBuckets) {
+            FreeList& list = freeLists()[bucket];
+            if (FreeFrame* frame = list.first_) {
+                list.first_ = frame->next_;
+                list.count_--;
+                return frame;
+            }
+            return ::operator new((bucket + 1) * granularity);
+        }
+        return ::operator new(size);
+    }
+
+    static void deallocate(void* ptr, std::size_t size) {
+        std::size_t bucket = bucketFor(size);
+        if (bucket < numBuckets) {
+            FreeList& list = freeLists()[bucket];
+            if (list.count_ < maxFramesPerBucket) {
+                auto frame = static_cast<FreeFrame*>(ptr);
+                frame->next_ = list.first_;
+                list.first_ = frame;
+                list.count_++;
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    //! The frame sizes are rounded up to multiples of this
+    static constexpr std::size_t granularity = 64;
+    //! The number of size buckets; bigger frames are not recycled
+    static constexpr std::size_t numBuckets = 16;
+    //! The maximum number of free frames kept for each bucket, on each thread
+    static constexpr int maxFramesPerBucket = 256;
+
+    struct FreeFrame {
+        FreeFrame* next_;
+    };
+    struct FreeList {
+        FreeFrame* first_{nullptr};
+        int count_{0};
+    };
+    //! The free lists of the current thread; frees the frames when the thread exits
+    struct ThreadFreeLists {
+        FreeList lists_[numBuckets];
+
+        ~ThreadFreeLists() {
+            for (auto& list : lists_) {
+                while (FreeFrame* frame = list.first_) {
+                    list.first_ = frame->next_;
+                    ::operator delete(frame);
+                }
+            }
+        }
+    };
+
+    static std::size_t bucketFor(std::size_t size) { return (size - 1) / granularity; }
+
+    static FreeList* freeLists() {
+        thread_local ThreadFreeLists lists;
+        return lists.lists_;
+    }
+};
+
+template <typename T>
+class CoTask;
+
+//! Awaiter used at the end of a CoTask; resumes the awaiting coroutine, if there is one
+struct CoTaskFinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept;
+    void await_resume() noexcept {}
+};
+
+//! Parts of the promise of CoTask that don't depend on the result type
+class CoTaskPromiseBase {
+public:
+    static void* operator new(std::size_t size) { return CoroutineFrameAllocator::allocate(size); }
+    static void operator delete(void* ptr, std::size_t size) {
+        CoroutineFrameAllocator::deallocate(ptr, size);
+    }
+
+    //! The tasks are lazy; they start only when awaited (or detached)
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    //! At the end, transfer the control directly to the awaiting coroutine (if any)
+    CoTaskFinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    //! The coroutine to resume when this one completes
+    std::coroutine_handle<> continuation_;
+    //! True if nobody awaits this coroutine; the frame is destroyed on completion
+    bool detached_{false};
+};
+
+template <typename Promise>
+std::coroutine_handle<> CoTaskFinalAwaiter::await_suspend(
+        std::coroutine_handle<Promise> h) noexcept {
+    CoTaskPromiseBase& promise = h.promise();
+    if (promise.continuation_)
+        return promise.continuation_;
+    if (promise.detached_)
+        h.destroy();
+    return std::noop_coroutine();
+}
+
+/**
+ * @brief      Coroutine type for task-based code.
+ *
+ * Lazily started: the body starts executing when the task is awaited, or when detach() is called.
+ * When the coroutine completes, it transfers the control directly to the awaiting coroutine
+ * (symmetric transfer), without going through an executor.
+ *
+ * Use 'co_await executor' to move the execution of the coroutine to an executor. As a
+ * TaskSerializer is an executor, 'co_await serializer' enters the critical section of the
+ * serializer, and a subsequent 'co_await executor' leaves it. The coroutine must not be suspended
+ * in other ways while inside the critical section.
+ */
+template <typename T = void>
+class CoTask {
+public:
+    class promise_type : public CoTaskPromiseBase {
+    public:
+        CoTask get_return_object() {
+            return CoTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        void return_value(T value) { value_ = std::move(value); }
+
+        T value_{};
+    };
+
+    CoTask(CoTask&& other) noexcept
+        : handle_(std::exchange(other.handle_, {})) {}
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~CoTask() { reset(); }
+
+    //! Starts the coroutine without anybody awaiting it; the frame is freed on completion
+    void detach() {
+        auto h = std::exchange(handle_, {});
+        h.promise().detached_ = true;
+        h.resume();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle_;
+
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle_.promise().continuation_ = awaiting;
+                return handle_;
+            }
+            T await_resume() { return std::move(handle_.promise().value_); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    explicit CoTask(std::coroutine_handle<promise_type> h)
+        : handle_(h) {}
+
+    void reset() {
+        if (handle_)
+            std::exchange(handle_, {}).destroy();
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <>
+class CoTask<void>::promise_type : public CoTaskPromiseBase {
+public:
+    CoTask get_return_object() {
+        return CoTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    void return_void() {}
+};
+
+template <>
+inline auto CoTask<void>::operator co_await() && noexcept {
+    struct Awaiter {
+        std::coroutine_handle<promise_type> handle_;
+
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle_.promise().continuation_ = awaiting;
+            return handle_;
+        }
+        void await_resume() {}
+    };
+    return Awaiter{handle_};
+}
+
+//! Awaitable that resumes the awaiting coroutine as a task on the given executor
+struct ScheduleAwaiter {
+    TaskExecutor& executor_;
+    TaskPriority priority_;
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        executor_.enqueue([h] { h.resume(); }, priority_);
+    }
+    void await_resume() noexcept {}
+};
+
+//! Moves the execution of the current coroutine to the given executor, with the given priority
+inline ScheduleAwaiter schedule(TaskExecutor& executor, TaskPriority prio = TaskPriority::normal) {
+    return ScheduleAwaiter{executor, prio};
+}
+
+//! Allows writing 'co_await executor' (or 'co_await serializer')
+inline ScheduleAwaiter operator co_await(TaskExecutor& executor) { return schedule(executor); }
+
+#endif
@@ -0,0 +1,398 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! Value type for the futures of continuations that don't return anything
+struct Unit {};
+
+template <typename T>
+class Future;
+template <typename T>
+class Promise;
+
+/**
+ * @brief      The state shared between a Promise and its Future.
+ *
+ * Holds the value (once set), the continuation to be executed when the value is set, and the
+ * executor on which the continuation runs. This is the only allocation for a promise/future pair;
+ * it is reference counted intrusively.
+ */
+template <typename T>
+class FutureState {
+public:
+    explicit FutureState(TaskExecutorPtr executor)
+        : executor_(std::move(executor)) {}
+    ~FutureState() {
+        if (flags_.load(std::memory_order_relaxed) & hasValue)
+            value().~T();
+    }
+
+    FutureState(const FutureState&) = delete;
+    FutureState& operator=(const FutureState&) = delete;
+
+    void addRef() { refCount_.fetch_add(1, std::memory_order_relaxed); }
+    void release() {
+        if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    //! The executor on which the continuations are executed
+    const TaskExecutorPtr& executor() const { return executor_; }
+
+    //! Checks if the value was set
+    bool isReady() const { return (flags_.load(std::memory_order_acquire) & hasValue) != 0; }
+
+    //! The value of the state; valid only after the value was set
+    T& value() { return *reinterpret_cast<T*>(&storage_); }
+
+    //! Sets the value, and triggers the continuation if there is one.
+    template <typename U>
+    void setValue(U&& val) {
+        new (&storage_) T(std::forward<U>(val));
+        int prev = flags_.fetch_or(hasValue, std::memory_order_acq_rel);
+        assert(!(prev & hasValue));
+        if (prev & hasContinuation)
+            runContinuation();
+    }
+
+    //! Sets the continuation to be executed once the value is set.
+    //! If the value is already set, the continuation is executed inline, right away. Otherwise, it
+    //! will be enqueued on the executor when the value is set, or, if 'runInline' is true, executed
+    //! on the thread that sets the value.
+    void setContinuation(Task cont, bool runInline) {
+        continuation_ = std::move(cont);
+        continuationInline_ = runInline;
+        int prev = flags_.fetch_or(hasContinuation, std::memory_order_acq_rel);
+        assert(!(prev & hasContinuation));
+        if (prev & hasValue) {
+            Task c = std::move(continuation_);
+            c();
+        }
+    }
+
+private:
+    enum { hasValue = 1, hasContinuation = 2 };
+
+    //! The number of references to this object
+    std::atomic<int> refCount_{1};
+    //! Indicates whether the value and/or the continuation were set
+    std::atomic<int> flags_{0};
+    //! Storage for the value
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+    //! The executor used for the continuations
+    TaskExecutorPtr executor_;
+    //! The continuation to run when the value is set
+    Task continuation_;
+    //! True if the continuation should run on the thread setting the value
+    bool continuationInline_{false};
+
+    void runContinuation() {
+        Task c = std::move(continuation_);
+        if (continuationInline_)
+            c();
+        else
+            executor_->enqueue(std::move(c));
+    }
+};
+
+//! The type returned by a continuation of type F, receiving a value of type T
+template <typename F, typename T>
+using ContinuationResult = decltype(std::declval<std::decay_t<F>&>()(std::declval<T&&>()));
+
+//! Calls a continuation and sets its result into a future state; void results become Unit
+template <typename FnResult>
+struct ContinuationInvoker {
+    using ValueType = FnResult;
+
+    template <typename F, typename A>
+    static void invoke(FutureState<ValueType>& result, F& f, A&& arg) {
+        result.setValue(f(std::forward<A>(arg)));
+    }
+};
+template <>
+struct ContinuationInvoker<void> {
+    using ValueType = Unit;
+
+    template <typename F, typename A>
+    static void invoke(FutureState<ValueType>& result, F& f, A&& arg) {
+        f(std::forward<A>(arg));
+        result.setValue(Unit{});
+    }
+};
+
+/**
+ * @brief      A value that will be available at some point in the future.
+ *
+ * The future is bound to an executor: continuations attached with then() are enqueued on that
+ * executor once the value is available. If the value is already available when then() is called,
+ * the continuation is executed inline, without going through the executor.
+ *
+ * Move-only; attaching a continuation consumes the future.
+ */
+template <typename T>
+class Future {
+public:
+    Future() = default;
+    Future(Future&& other) noexcept
+        : state_(other.state_) {
+        other.state_ = nullptr;
+    }
+    Future& operator=(Future&& other) noexcept {
+        if (this != &other) {
+            reset();
+            state_ = other.state_;
+            other.state_ = nullptr;
+        }
+        return *this;
+    }
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+    ~Future() { reset(); }
+
+    //! Checks if this future refers to a shared state
+    bool valid() const { return state_ != nullptr; }
+    //! Checks if the value of this future is available
+    bool isReady() const { return state_ && state_->isReady(); }
+
+    //! Attaches a continuation that receives the value of this future.
+    //! Returns the future of the value returned by the continuation (Unit if it returns void).
+    template <typename F>
+    Future<typename ContinuationInvoker<ContinuationResult<F, T>>::ValueType> then(F&& f) && {
+        using Invoker = ContinuationInvoker<ContinuationResult<F, T>>;
+        using R = typename Invoker::ValueType;
+        assert(state_);
+
+        auto result = new FutureState<R>(state_->executor());
+        result->addRef(); // one reference for the continuation, one for the returned future
+        FutureState<T>* src = state_;
+        state_ = nullptr;
+        src->setContinuation(
+                [src, result, f = std::forward<F>(f)]() mutable {
+                    Invoker::invoke(*result, f, std::move(src->value()));
+                    src->release();
+                    result->release();
+                },
+                false);
+        return Future<R>(result);
+    }
+
+private:
+    template <typename U>
+    friend class Future;
+    friend class Promise<T>;
+    template <typename U>
+    friend Future<U> makeReadyFuture(TaskExecutorPtr executor, U value);
+    template <typename... Ts>
+    friend Future<std::tuple<Ts...>> whenAll(Future<Ts>... futures);
+    template <typename U>
+    friend Future<std::vector<U>> whenAll(std::vector<Future<U>> futures);
+    template <typename U>
+    friend Future<std::pair<std::size_t, U>> whenAny(std::vector<Future<U>> futures);
+    template <typename Join, typename U, typename Store>
+    friend void attachJoinInput(Future<U>& input, Join* join, Store store);
+
+    explicit Future(FutureState<T>* state)
+        : state_(state) {}
+
+    //! Takes the shared state out of this future
+    FutureState<T>* detach() {
+        assert(state_);
+        FutureState<T>* s = state_;
+        state_ = nullptr;
+        return s;
+    }
+
+    void reset() {
+        if (state_) {
+            state_->release();
+            state_ = nullptr;
+        }
+    }
+
+    //! The state shared with the promise
+    FutureState<T>* state_{nullptr};
+};
+
+//! The producer side of a Future
+template <typename T>
+class Promise {
+public:
+    //! Creates a promise whose future runs its continuations on the given executor
+    explicit Promise(TaskExecutorPtr executor)
+        : state_(new FutureState<T>(std::move(executor))) {}
+    Promise(Promise&& other) noexcept
+        : state_(other.state_) {
+        other.state_ = nullptr;
+    }
+    Promise& operator=(Promise&& other) noexcept {
+        if (this != &other) {
+            if (state_)
+                state_->release();
+            state_ = other.state_;
+            other.state_ = nullptr;
+        }
+        return *this;
+    }
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+    ~Promise() {
+        if (state_)
+            state_->release();
+    }
+
+    //! Returns the future corresponding to this promise; must be called only once
+    Future<T> getFuture() {
+        assert(state_);
+        state_->addRef();
+        return Future<T>(state_);
+    }
+
+    //! Sets the value of the promise, making the future ready; must be called only once
+    template <typename U>
+    void setValue(U&& val) {
+        assert(state_);
+        state_->setValue(std::forward<U>(val));
+    }
+
+private:
+    //! The state shared with the future
+    FutureState<T>* state_;
+};
+
+//! Creates a future that already has a value
+template <typename T>
+Future<T> makeReadyFuture(TaskExecutorPtr executor, T value) {
+    auto state = new FutureState<T>(std::move(executor));
+    state->setValue(std::move(value));
+    return Future<T>(state);
+}
+
+//! Joins the values of several futures; the resulting state is created when the last input is set
+template <typename Result>
+struct WhenAllJoin {
+    //! The values of the input futures
+    Result values_;
+    //! The number of inputs that don't have a value yet
+    std::atomic<std::size_t> remaining_;
+    //! The state of the resulting future
+    FutureState<Result>* result_;
+
+    WhenAllJoin(std::size_t count, FutureState<Result>* result)
+        : remaining_(count)
+        , result_(result) {}
+
+    //! Called each time an input is set; publishes the result after the last input
+    void onInputDone() {
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            result_->setValue(std::move(values_));
+            result_->release();
+            delete this;
+        }
+    }
+};
+
+template <typename Join, typename T, typename Store>
+void attachJoinInput(Future<T>& input, Join* join, Store store) {
+    // The input continuations are tiny; run them on the thread that sets the input value
+    FutureState<T>* src = input.detach();
+    src->setContinuation(
+            [src, join, store] {
+                store(*join, std::move(src->value()));
+                src->release();
+                join->onInputDone();
+            },
+            true);
+}
+
+template <typename Join, typename Tuple, std::size_t... Is>
+void attachWhenAllInputs(Join* join, Tuple& futures, std::index_sequence<Is...>) {
+    using Expand = int[];
+    (void)Expand{0, (attachJoinInput(std::get<Is>(futures), join,
+                             [](Join& j, auto&& val) {
+                                 std::get<Is>(j.values_) = std::forward<decltype(val)>(val);
+                             }),
+                            0)...};
+}
+
+//! Returns a future that becomes ready once all the given futures are ready, holding all their
+//! values. The continuations of the resulting future run on the executor of the first input.
+//! The value types must be default-constructible.
+template <typename... Ts>
+Future<std::tuple<Ts...>> whenAll(Future<Ts>... futures) {
+    static_assert(sizeof...(Ts) > 0, "whenAll needs at least one future");
+    using Result = std::tuple<Ts...>;
+    using Join = WhenAllJoin<Result>;
+
+    auto futuresTuple = std::forward_as_tuple(futures...);
+    auto result = new FutureState<Result>(std::get<0>(futuresTuple).state_->executor());
+    result->addRef(); // one reference for the join, one for the returned future
+    auto join = new Join(sizeof...(Ts), result);
+    attachWhenAllInputs(join, futuresTuple, std::index_sequence_for<Ts...>{});
+    return Future<Result>(result);
+}
+
+//! Returns a future that becomes ready once all the given futures are ready, holding their values
+//! in order. The given vector must not be empty. The value type must be default-constructible.
+template <typename T>
+Future<std::vector<T>> whenAll(std::vector<Future<T>> futures) {
+    assert(!futures.empty());
+    using Result = std::vector<T>;
+    using Join = WhenAllJoin<Result>;
+
+    auto result = new FutureState<Result>(futures[0].state_->executor());
+    result->addRef(); // one reference for the join, one for the returned future
+    auto join = new Join(futures.size(), result);
+    join->values_.resize(futures.size());
+    for (std::size_t i = 0; i < futures.size(); i++)
+        attachJoinInput(futures[i], join, [i](Join& j, T&& val) { j.values_[i] = std::move(val); });
+    return Future<Result>(result);
+}
+
+//! Returns a future that becomes ready as soon as one of the given futures is ready. Holds the
+//! index and the value of the first future that became ready. The given vector must not be empty.
+template <typename T>
+Future<std::pair<std::size_t, T>> whenAny(std::vector<Future<T>> futures) {
+    assert(!futures.empty());
+    using Result = std::pair<std::size_t, T>;
+
+    struct AnyJoin {
+        //! Set when the first input is ready
+        std::atomic<bool> done_{false};
+        //! The number of inputs not yet ready; the join is deleted after the last one
+        std::atomic<std::size_t> remaining_;
+        //! The state of the resulting future
+        FutureState<Result>* result_;
+
+        AnyJoin(std::size_t count, FutureState<Result>* result)
+            : remaining_(count)
+            , result_(result) {}
+    };
+
+    auto result = new FutureState<Result>(futures[0].state_->executor());
+    result->addRef(); // one reference for the join, one for the returned future
+    auto join = new AnyJoin(futures.size(), result);
+    for (std::size_t i = 0; i < futures.size(); i++) {
+        FutureState<T>* src = futures[i].detach();
+        src->setContinuation(
+                [src, join, i] {
+                    if (!join->done_.exchange(true, std::memory_order_acq_rel)) {
+                        join->result_->setValue(Result(i, std::move(src->value())));
+                        join->result_->release();
+                    }
+                    src->release();
+                    if (join->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        delete join;
+                },
+                true);
+    }
+    return Future<Result>(result);
+}
@@ -1,10 +1,77 @@
 #pragma once
 
 #include "TaskExecutor.hpp"
+#include "Instrumentation.hpp"
 
+#include "tbb/concurrent_queue.h"
+#include "tbb/task_arena.h"
+
+#include <atomic>
+
+/**
+ * @brief      Executor that runs the tasks on the TBB worker threads.
+ *
+ * The tasks are enqueued in an explicit TBB arena owned by the executor. The arena controls the
+ * maximum concurrency of the executor, its priority relative to the other arenas, and possibly the
+ * NUMA node on which the tasks are executed.
+ *
+ * Task priorities are handled inside the arena: the tasks are kept in one queue per priority, and
+ * each enqueue adds to the arena a task that runs the highest priority task available at that
+ * time. We don't use one arena per priority, as that would multiply the concurrency of the
+ * executor, and moving the TBB workers between arenas is slow.
+ *
+ * The tasks that are not yet executed when the executor is destroyed are discarded. The executor
+ * must not be destroyed from one of its own tasks.
+ */
 class GlobalTaskExecutor : public TaskExecutor {
 public:
-    GlobalTaskExecutor();
+    using Priority = tbb::task_arena::priority;
+
+    //! Creates the executor, with the given concurrency level and priority.
+    //! By default, the concurrency level is the one chosen by TBB.
+    explicit GlobalTaskExecutor(
+            int concurrency = tbb::task_arena::automatic, Priority priority = Priority::normal);
+    //! Creates the executor, with an arena with the given constraints (NUMA node, core type, etc.)
+    explicit GlobalTaskExecutor(
+            tbb::task_arena::constraints constraints, Priority priority = Priority::normal);
+    ~GlobalTaskExecutor();
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) final;
+    //! Checks if the current thread is executing one of the tasks of this executor
+    bool isWorkerThread() const final { return currentExecutor_ == this; }
+
+#if TASKS_INSTRUMENTATION
+    //! Returns the current values of the counters of this executor
+    ExecutorCountersSnapshot counters() const { return counters_.snapshot(); }
+#endif
+
+private:
+    //! A task waiting in our queues
+    struct QueuedTask {
+        Task task_;
+#if TASKS_INSTRUMENTATION
+        //! The time at which the task was enqueued
+        std::int64_t enqueueTimeNs_{ExecutorCounters::nowNs()};
+#endif
+    };
+
+    //! The executor whose task is being executed by the current thread, if any. The TBB threads
+    //! are shared between arenas, so a thread belongs to us only while it runs one of our tasks.
+    static thread_local const GlobalTaskExecutor* currentExecutor_;
+
+    //! The TBB arena in which we execute the tasks
+    tbb::task_arena arena_;
+    //! The tasks waiting to be executed, one queue for each task priority
+    tbb::concurrent_queue<QueuedTask> tasks_[numTaskPriorities];
+    //! The number of tasks enqueued in the arena that didn't finish yet. The arena doesn't wait
+    //! for them when destroyed, so we do it ourselves.
+    std::atomic<int> numArenaTasks_{0};
+#if TASKS_INSTRUMENTATION
+    //! Counters about the tasks that go through this executor
+    ExecutorCounters counters_;
+#endif
 
-    void enqueue(Task t) override;
+    //! Executes the highest priority task from our queues; this is the body of the arena tasks
+    void runOneTask();
 };
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//! Set to 1 to make the executors keep counters about their tasks (see ExecutorCounters).
+//! When 0, the executors don't keep any counters, and don't pay anything for them.
+#ifndef TASKS_INSTRUMENTATION
+#define TASKS_INSTRUMENTATION 0
+#endif
+
+//! Histogram of durations, with power-of-two buckets
+struct TimeHistogram {
+    //! The number of buckets; bucket 0 counts zero durations, bucket i counts the durations in the
+    //! range [2^(i-1), 2^i) nanoseconds, and the last bucket also counts the longer durations
+    static constexpr int numBuckets = 40;
+
+    std::uint64_t counts_[numBuckets] = {};
+
+    //! Returns the bucket for the given duration
+    static int bucketFor(std::int64_t ns);
+
+    //! Returns the total number of durations in the histogram
+    std::uint64_t count() const;
+    //! Returns an upper bound of the given percentile (0 < p <= 1), in nanoseconds
+    std::int64_t percentileNs(double p) const;
+};
+
+//! The values of the counters of an executor at one point in time
+struct ExecutorCountersSnapshot {
+    //! The number of tasks enqueued
+    std::uint64_t tasksEnqueued_{0};
+    //! The number of tasks whose execution completed
+    std::uint64_t tasksExecuted_{0};
+    //! The number of enqueued tasks that did not start yet, or are in execution
+    std::int64_t depth_{0};
+    //! The maximum value of depth_ so far
+    std::int64_t maxDepth_{0};
+    //! The number of tasks enqueued while the executor was busy executing other tasks.
+    //! Only counted by serializers.
+    std::uint64_t busyEnqueues_{0};
+    //! The time between enqueueing the tasks and starting their execution
+    TimeHistogram queueLatency_;
+    //! The time spent executing the tasks
+    TimeHistogram executionTime_;
+};
+
+/**
+ * @brief      Counters about the tasks that go through an executor.
+ *
+ * Used by the executors when TASKS_INSTRUMENTATION is enabled. The counters are sharded by thread,
+ * so that the threads updating them don't contend with each other; the shards are allocated the
+ * first time a thread updates the counters. The depth of the queue is the exception: it is kept in
+ * a shared counter, so that its maximum value can be tracked.
+ *
+ * A snapshot of the counters can be taken at any time, without stopping the updates; the values in
+ * the snapshot are not necessarily consistent with each other.
+ */
+class ExecutorCounters {
+public:
+    ExecutorCounters();
+    ~ExecutorCounters();
+    ExecutorCounters(const ExecutorCounters&) = delete;
+    ExecutorCounters& operator=(const ExecutorCounters&) = delete;
+
+    //! Returns the current time, in the form expected by the other functions
+    static std::int64_t nowNs();
+
+    //! Called when a task is enqueued
+    void onEnqueue();
+    //! Called when the enqueued task finds the executor busy with other tasks
+    void onFoundBusy();
+    //! Called when a task starts executing; returns the start time
+    std::int64_t onStart(std::int64_t enqueueTimeNs);
+    //! Called when a task completes its execution
+    void onEnd(std::int64_t startTimeNs);
+
+    //! Aggregates the counters from all the shards
+    ExecutorCountersSnapshot snapshot() const;
+
+private:
+    struct Shard;
+
+    //! The maximum number of shards; threads beyond this number share shards
+    static constexpr int numShards = 16;
+
+    //! Returns the shard for the current thread, creating it if needed
+    Shard& localShard();
+
+    std::atomic<Shard*> shards_[numShards];
+    std::atomic<std::int64_t> depth_{0};
+    std::atomic<std::int64_t> maxDepth_{0};
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//! Base class for the nodes that can be added to an MpscQueue
+struct MpscNode {
+    //! The next node in the queue
+    std::atomic<MpscNode*> next_{nullptr};
+};
+
+/**
+ * @brief      Intrusive, lock-free, multi-producer single-consumer queue.
+ *
+ * Based on Dmitry Vyukov's node-based MPSC queue. The nodes are owned by the caller; the queue just
+ * links them together.
+ *
+ * Besides the nodes, the queue also keeps track of whether a consumer is active. When the queue is
+ * empty and no consumer is draining it, the tail pointer (the producer end) is tagged. Pushing a
+ * node is a single atomic exchange on the tail, and reports whether the push made the queue go from
+ * idle to active; in that case, the caller is responsible for starting a consumer. The consumer
+ * stops by calling tryMarkIdle() once pop() doesn't return anything.
+ */
+class MpscQueue {
+public:
+    MpscQueue()
+        : tail_(tagged(&stub_))
+        , head_(&stub_) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    //! Adds a node to the queue. Can be called from multiple threads.
+    //! Returns true if the queue was idle before this push; the caller needs to start a consumer.
+    bool push(MpscNode* node) {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        std::uintptr_t prev = tail_.exchange(
+                reinterpret_cast<std::uintptr_t>(node), std::memory_order_acq_rel);
+        untag(prev)->next_.store(node, std::memory_order_release);
+        return isTagged(prev);
+    }
+
+    //! Adds a chain of nodes to the queue, with a single atomic operation. The nodes from 'first'
+    //! to 'last' need to be already linked together through their next_ pointers.
+    //! Can be called from multiple threads. Returns true if the queue was idle before this push.
+    bool pushChain(MpscNode* first, MpscNode* last) {
+        last->next_.store(nullptr, std::memory_order_relaxed);
+        std::uintptr_t prev = tail_.exchange(
+                reinterpret_cast<std::uintptr_t>(last), std::memory_order_acq_rel);
+        untag(prev)->next_.store(first, std::memory_order_release);
+        return isTagged(prev);
+    }
+
+    //! Extracts the first node from the queue. Must be called only by the active consumer.
+    //! Returns null if there are no nodes that can be extracted right now. This can happen if a
+    //! producer is in the middle of a push.
+    MpscNode* pop() {
+        MpscNode* head = head_;
+        MpscNode* next = head->next_.load(std::memory_order_acquire);
+        // Skip the stub node
+        if (head == &stub_) {
+            if (!next)
+                return nullptr;
+            head_ = next;
+            head = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+        if (next) {
+            head_ = next;
+            return head;
+        }
+        // 'head' is the last node; we can extract it only after placing the stub node behind it
+        if (head != untag(tail_.load(std::memory_order_acquire)))
+            return nullptr;
+        push(&stub_);
+        next = head->next_.load(std::memory_order_acquire);
+        if (next) {
+            head_ = next;
+            return head;
+        }
+        return nullptr;
+    }
+
+    //! Called by the active consumer when it wants to stop consuming.
+    //! If the queue is empty, mark it as idle and return true; the next push will report that a
+    //! new consumer needs to be started. Otherwise return false; the consumer remains active.
+    bool tryMarkIdle() {
+        if (head_ != &stub_ || stub_.next_.load(std::memory_order_acquire))
+            return false;
+        auto expected = reinterpret_cast<std::uintptr_t>(&stub_);
+        return tail_.compare_exchange_strong(expected, tagged(&stub_), std::memory_order_acq_rel);
+    }
+
+private:
+    //! The last node in the queue, where producers add nodes; tagged if the queue is idle
+    std::atomic<std::uintptr_t> tail_;
+    //! Keeps the producer end and the consumer end on different cache lines
+    char padding_[64 - sizeof(std::atomic<std::uintptr_t>)];
+    //! The first node in the queue; only used by the consumer
+    MpscNode* head_;
+    //! Node always present in the queue, so that we can extract all the other nodes
+    MpscNode stub_;
+
+    static std::uintptr_t tagged(MpscNode* node) {
+        return reinterpret_cast<std::uintptr_t>(node) | 1;
+    }
+    static bool isTagged(std::uintptr_t p) { return (p & 1) != 0; }
+    static MpscNode* untag(std::uintptr_t p) {
+        return reinterpret_cast<MpscNode*>(p & ~std::uintptr_t(1));
+    }
+};
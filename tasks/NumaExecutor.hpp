@@ -0,0 +1,53 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+#include "WorkStealingExecutor.hpp"
+#include "NumaTopology.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief      Executor composed of sub-executors pinned to NUMA nodes (or to arbitrary core sets).
+ *
+ * Each sub-executor is a WorkStealingExecutor whose worker threads are pinned to the CPUs of one
+ * node. The sub-executors can be used directly, as regular executors; for example, a TaskSerializer
+ * declares its home node by using the sub-executor of that node as its base executor; this way, all
+ * its tasks (and the accesses to the data it protects) stay on that node.
+ *
+ * Tasks enqueued directly into this executor stay on the node of the calling thread, if the thread
+ * belongs to one of the sub-executors; otherwise they are distributed round-robin across nodes.
+ *
+ * On a single-node machine there is a single sub-executor, and the threads are not pinned.
+ */
+class NumaExecutor : public TaskExecutor {
+public:
+    //! Creates one sub-executor for each NUMA node of the machine
+    NumaExecutor();
+    //! Creates one sub-executor for each of the given core sets
+    explicit NumaExecutor(const std::vector<std::vector<int>>& coreSets);
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) override;
+    //! Checks if the current thread is a worker thread of one of the nodes
+    bool isWorkerThread() const override;
+
+    //! Returns the number of nodes (sub-executors)
+    int numNodes() const { return int(nodeExecutors_.size()); }
+
+    //! Returns the sub-executor for the given node.
+    //! The node index is taken modulo the number of nodes, so any index is valid.
+    TaskExecutorPtr nodeExecutor(int nodeIdx) const {
+        return nodeExecutors_[std::size_t(nodeIdx) % nodeExecutors_.size()];
+    }
+
+private:
+    //! The sub-executors, one per node
+    std::vector<std::shared_ptr<WorkStealingExecutor>> nodeExecutors_;
+    //! Counter used to distribute tasks from external threads
+    std::atomic<unsigned> nextNode_{0};
+
+    //! Creates the sub-executors for the given core sets
+    void createNodeExecutors(const std::vector<std::vector<int>>& coreSets);
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//! A NUMA node of the machine, with the CPUs that belong to it
+struct NumaNode {
+    //! The OS identifier of the node
+    int id_;
+    //! The OS identifiers of the CPUs in this node
+    std::vector<int> cpus_;
+};
+
+/**
+ * @brief      Discovers the NUMA topology of the machine.
+ *
+ * On Linux, the nodes are read from /sys/devices/system/node. If the topology cannot be read (or on
+ * other platforms), the machine is considered to have a single node. For a single node, the list
+ * of CPUs may be empty, meaning "all the CPUs".
+ */
+std::vector<NumaNode> discoverNumaTopology();
+
+//! Parses a Linux CPU list (e.g., "0-3,8,10-11") into the list of CPU identifiers
+std::vector<int> parseCpuList(const std::string& cpuList);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief      Serializer that lets read-only tasks execute in parallel with each other.
+ *
+ * Write tasks are executed one at a time, and never in parallel with read tasks; read tasks can be
+ * executed in parallel with other read tasks. All the tasks are executed on the base executor.
+ *
+ * The tasks are admitted in the order they were enqueued. Consecutive read tasks are dispatched to
+ * the base executor together, while a write task waits for all the tasks enqueued before it to
+ * complete. To keep the writers from starving, read tasks that arrive while a write task is waiting
+ * are queued behind it, instead of joining the reads that are in execution; when the write task
+ * completes, all the reads that queued behind it start together, so that readers cannot starve
+ * either.
+ *
+ * The priority of a task only affects how it is enqueued on the base executor, once the task is
+ * admitted; it doesn't change the admission order.
+ *
+ * Enqueueing a task through the TaskExecutor interface enqueues a write task.
+ *
+ * Destroying the serializer waits for the admitted tasks to complete, and discards the tasks that
+ * are still waiting to be admitted; the serializer must not be destroyed from one of its tasks.
+ */
+class SharedTaskSerializer : public TaskExecutor {
+public:
+    explicit SharedTaskSerializer(TaskExecutorPtr executor);
+    ~SharedTaskSerializer();
+
+    //! Enqueues a read-only task; it may execute in parallel with other read tasks
+    void enqueueRead(Task t, TaskPriority prio = TaskPriority::normal);
+    //! Enqueues a task that needs exclusive access
+    void enqueueWrite(Task t, TaskPriority prio = TaskPriority::normal);
+
+    using TaskExecutor::enqueue;
+    //! Enqueues a write task
+    void enqueue(Task t, TaskPriority prio) override { enqueueWrite(std::move(t), prio); }
+
+private:
+    //! A task waiting to be admitted, or in execution
+    struct TaskNode {
+        Task task_;
+        TaskPriority priority_;
+        bool isWrite_;
+        TaskNode* next_{nullptr};
+
+        TaskNode(Task t, TaskPriority prio, bool isWrite)
+            : task_(std::move(t))
+            , priority_(prio)
+            , isWrite_(isWrite) {}
+    };
+
+    //! The base executor we are using for executing the tasks passed to the serializer
+    TaskExecutorPtr baseExecutor_;
+    //! Protects the fields below
+    std::mutex mutex_;
+    //! The first of the tasks waiting to be admitted, in the order they were enqueued
+    TaskNode* firstWaiting_{nullptr};
+    //! The last of the tasks waiting to be admitted
+    TaskNode* lastWaiting_{nullptr};
+    //! The number of read tasks admitted, and not yet completed
+    int numActiveReaders_{0};
+    //! True if a write task is admitted, and not yet completed
+    bool writerActive_{false};
+    //! The number of tasks given to the base executor, and not yet completed; unlike the fields
+    //! above, it also covers the bookkeeping done after each task
+    std::atomic<int> numDispatched_{0};
+
+    //! Adds a task to the serializer; dispatches it right away if it can be admitted
+    void add(TaskNode* node);
+    //! Called when a task completes; dispatches the tasks that can now be admitted
+    void onTaskDone(bool wasWrite);
+    //! Takes out of the waiting list the tasks that can be admitted; called with the mutex locked,
+    //! when there are no tasks in execution. Returns the list of admitted tasks.
+    TaskNode* admitWaitingTasks();
+    //! Enqueues the given list of admitted tasks on the base executor
+    void dispatch(TaskNode* first);
+    //! Executes an admitted task; called on the base executor
+    void execute(TaskNode* node);
+};
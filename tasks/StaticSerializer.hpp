@@ -0,0 +1,132 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+#include "TaskSerializerCore.hpp"
+
+#include <cassert>
+
+/**
+ * @brief      Serializer whose base executor is known at compile time.
+ *
+ * Behaves like TaskSerializer, but it refers to its base executor by its concrete type, and without
+ * holding a shared pointer to it. The drain tasks are given directly to the base executor, without
+ * any virtual calls (provided that the base executor's enqueue() is final or non-virtual), and
+ * without touching any reference counts. The serializer is itself a static executor, so serializers
+ * can be stacked on top of each other. It doesn't derive from TaskExecutor; to use it where a
+ * TaskExecutorPtr is expected, wrap it in a TaskExecutorAdapter.
+ *
+ * Like TaskSerializer, it can be bounded, through the options; enqueue() and enqueueBulk() assert
+ * that no task is rejected.
+ *
+ * The base executor needs to outlive the serializer. Destroying the serializer waits for its drain
+ * in progress, if any, to finish, just like for TaskSerializer.
+ *
+ * @tparam     BaseExecutor  The type of the base executor; must satisfy isTaskExecutor
+ */
+template <typename BaseExecutor>
+class StaticSerializer {
+    static_assert(isTaskExecutor<BaseExecutor>::value, "the base executor must be an executor");
+
+public:
+    explicit StaticSerializer(BaseExecutor& executor, TaskSerializerOptions options = {})
+        : baseExecutor_(executor)
+        , core_(options) {}
+
+    ~StaticSerializer() { core_.waitForDrains(); }
+
+    StaticSerializer(const StaticSerializer&) = delete;
+    StaticSerializer& operator=(const StaticSerializer&) = delete;
+
+    //! Enqueues a task with the given priority
+    void enqueue(Task t, TaskPriority prio = TaskPriority::normal) {
+        if (core_.isBounded()) {
+            EnqueueStatus status = tryEnqueue(std::move(t), prio);
+            assert(status != EnqueueStatus::rejected && "use tryEnqueue() with the reject policy");
+            (void)status;
+            return;
+        }
+        // If the serializer was idle, start draining the queue
+        if (core_.push(std::move(t), prio))
+            startDrain(prio);
+    }
+
+    //! Enqueues the tasks in the range [first, last), with a single operation on our queue
+    void enqueueBulk(Task* first, Task* last, TaskPriority prio = TaskPriority::normal) {
+        // Bounded serializers need to check the capacity for each task
+        if (core_.isBounded()) {
+            for (; first != last; ++first) {
+                EnqueueStatus status = tryEnqueue(std::move(*first), prio);
+                assert(status != EnqueueStatus::rejected &&
+                        "use tryEnqueue() with the reject policy");
+                (void)status;
+            }
+            return;
+        }
+        if (core_.pushBulk(first, last, prio))
+            startDrain(prio);
+    }
+
+    //! Enqueues a task, applying the overflow policy if the serializer is bounded and full.
+    //! @see TaskSerializer::tryEnqueue
+    EnqueueStatus tryEnqueue(
+            Task t, TaskPriority prio = TaskPriority::normal, Task resume = nullptr) {
+        if (!core_.isBounded()) {
+            enqueue(std::move(t), prio);
+            return EnqueueStatus::enqueued;
+        }
+        bool wasIdle = false;
+        EnqueueStatus status = core_.pushBounded(std::move(t), prio, std::move(resume), wasIdle);
+        if (wasIdle)
+            startDrain(prio);
+        return status;
+    }
+
+    //! Returns the number of tasks in the serializer, if bounded; zero otherwise
+    std::size_t depth() const { return core_.depth(); }
+
+    //! Returns the base executor
+    BaseExecutor& baseExecutor() const { return baseExecutor_; }
+
+#if TASKS_INSTRUMENTATION
+    //! Returns the current values of the counters of this serializer
+    ExecutorCountersSnapshot counters() const { return core_.counters(); }
+#endif
+
+private:
+    //! The base executor we are using for executing the tasks passed to the serializer
+    BaseExecutor& baseExecutor_;
+    //! The queue of the serializer, and the logic of executing the tasks
+    TaskSerializerCore core_;
+
+    //! Starts draining our queue, after finding the serializer idle. Drains on the current thread
+    //! if allowed, otherwise enqueues a drain task.
+    void startDrain(TaskPriority prio) {
+        core_.beginDrain();
+        // If we are already on the base executor, we can avoid a round-trip through its queue
+        if (core_.canDrainInline(prio) && isWorkerThreadOf(baseExecutor_) &&
+                TaskSerializerCore::enterInlineDrain()) {
+            drain();
+            TaskSerializerCore::exitInlineDrain();
+            return;
+        }
+        enqueueDrain(prio);
+    }
+    //! Enqueues on the base executor a task that drains our queue
+    void enqueueDrain(TaskPriority prio) {
+        baseExecutor_.enqueue([this] { this->drain(); }, prio);
+    }
+    //! Executes tasks from our queue; called on the base executor
+    void drain() {
+        TaskPriority nextPrio;
+        bool hasMoreTasks = core_.drain(nextPrio);
+        // Resume the producers whose tasks got room in the serializer
+        Task resume;
+        while (core_.takeResumedProducer(resume))
+            baseExecutor_.enqueue(std::move(resume), TaskPriority::normal);
+        // The next drain hop takes over our mark; otherwise, this is the last access to our members
+        if (hasMoreTasks)
+            enqueueDrain(nextPrio);
+        else
+            core_.endDrain();
+    }
+};
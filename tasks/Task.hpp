@@ -1,5 +1,151 @@
 #pragma once
 
-#include <functional>
+#include "BlockPool.hpp"
 
-using Task = std::function<void()>;
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef TASKS_TASK_INLINE_SIZE
+//! The size (in bytes) of the buffer in which Task objects store their callables without allocating
+#define TASKS_TASK_INLINE_SIZE 48
+#endif
+
+//! The operations needed to manipulate a type-erased callable
+struct TaskVTable {
+    //! Invokes the callable found in the given storage
+    void (*invoke)(void* storage);
+    //! Moves the callable from 'src' into 'dst' and destroys the source
+    void (*relocate)(void* dst, void* src);
+    //! Destroys the callable found in the given storage
+    void (*destroy)(void* storage);
+};
+
+//! Operations for callables stored directly in the inline buffer of the task
+template <typename F>
+struct InlineTaskOps {
+    static F& get(void* storage) { return *static_cast<F*>(storage); }
+
+    static void invoke(void* storage) { get(storage)(); }
+    static void relocate(void* dst, void* src) {
+        new (dst) F(std::move(get(src)));
+        get(src).~F();
+    }
+    static void destroy(void* storage) { get(storage).~F(); }
+
+    static const TaskVTable vtable;
+};
+
+template <typename F>
+const TaskVTable InlineTaskOps<F>::vtable = {&invoke, &relocate, &destroy};
+
+//! Operations for callables that are too big for the inline buffer; we keep a pointer to them.
+//! The callables are allocated from the block pools, if they are not too big for them either.
+template <typename F>
+struct HeapTaskOps {
+    static F*& get(void* storage) { return *static_cast<F**>(storage); }
+
+    static void invoke(void* storage) { (*get(storage))(); }
+    static void relocate(void* dst, void* src) { new (dst) F*(get(src)); }
+    static void destroy(void* storage) { deletePooled(get(storage)); }
+
+    static const TaskVTable vtable;
+};
+
+template <typename F>
+const TaskVTable HeapTaskOps<F>::vtable = {&invoke, &relocate, &destroy};
+
+/**
+ * @brief      Move-only, type-erased callable used to represent tasks.
+ *
+ * Similar to std::function<void()>, but it does not require the callable to be copyable, and it
+ * keeps callables up to a given size in an inline buffer, without any heap allocation. Only the
+ * callables that don't fit into the buffer (or that can throw while moving) are heap-allocated.
+ *
+ * @tparam     inlineSize  The size of the inline buffer, in bytes
+ */
+template <std::size_t inlineSize>
+class BasicTask {
+    static_assert(inlineSize >= sizeof(void*), "The inline buffer must be able to hold a pointer");
+
+    //! Indicates whether the callable of type F can be stored in the inline buffer
+    template <typename F>
+    using fitsInline = std::integral_constant<bool,
+            sizeof(F) <= inlineSize && alignof(F) <= alignof(std::max_align_t) &&
+                    std::is_nothrow_move_constructible<F>::value>;
+
+public:
+    BasicTask() noexcept = default;
+    BasicTask(std::nullptr_t) noexcept {}
+
+    template <typename F,
+            typename = std::enable_if_t<!std::is_same<std::decay_t<F>, BasicTask>::value>>
+    BasicTask(F&& f) {
+        init(std::forward<F>(f), fitsInline<std::decay_t<F>>{});
+    }
+
+    BasicTask(BasicTask&& other) noexcept { moveFrom(other); }
+    BasicTask& operator=(BasicTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+    BasicTask& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    BasicTask(const BasicTask&) = delete;
+    BasicTask& operator=(const BasicTask&) = delete;
+
+    ~BasicTask() { reset(); }
+
+    //! Executes the task; the task must not be empty
+    void operator()() const {
+        assert(vtable_);
+        vtable_->invoke(&storage_);
+    }
+
+    //! Checks if we have a callable in this task
+    explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+private:
+    //! Storage for the callable (or for the pointer to the callable)
+    alignas(std::max_align_t) mutable unsigned char storage_[inlineSize];
+    //! The operations for the stored callable; null if the task is empty
+    const TaskVTable* vtable_{nullptr};
+
+    template <typename F>
+    void init(F&& f, std::true_type /*fitsInline*/) {
+        using Fn = std::decay_t<F>;
+        new (&storage_) Fn(std::forward<F>(f));
+        vtable_ = &InlineTaskOps<Fn>::vtable;
+    }
+    template <typename F>
+    void init(F&& f, std::false_type /*fitsInline*/) {
+        using Fn = std::decay_t<F>;
+        new (&storage_) Fn*(newPooled<Fn>(std::forward<F>(f)));
+        vtable_ = &HeapTaskOps<Fn>::vtable;
+    }
+
+    void moveFrom(BasicTask& other) noexcept {
+        if (other.vtable_) {
+            other.vtable_->relocate(&storage_, &other.storage_);
+            vtable_ = other.vtable_;
+            other.vtable_ = nullptr;
+        }
+    }
+
+    void reset() noexcept {
+        if (vtable_) {
+            vtable_->destroy(&storage_);
+            vtable_ = nullptr;
+        }
+    }
+};
+
+using Task = BasicTask<TASKS_TASK_INLINE_SIZE>;
@@ -3,10 +3,104 @@
 #include "Task.hpp"
 
 #include <memory>
+#include <type_traits>
+#include <utility>
+
+//! The priority of a task. Executors try to execute higher priority tasks first.
+enum class TaskPriority {
+    low,
+    normal,
+    high,
+};
+
+//! The number of task priority levels
+constexpr int numTaskPriorities = 3;
 
 class TaskExecutor {
 public:
-    virtual void enqueue(Task t) = 0;
+    //! Enqueues a task with normal priority
+    void enqueue(Task t) { enqueue(std::move(t), TaskPriority::normal); }
+
+    //! Enqueues a task with the given priority
+    virtual void enqueue(Task t, TaskPriority prio) = 0;
+
+    //! Enqueues the tasks in the range [first, last) with normal priority
+    void enqueueBulk(Task* first, Task* last) { enqueueBulk(first, last, TaskPriority::normal); }
+
+    //! Enqueues the tasks in the range [first, last), all with the given priority; the tasks are
+    //! moved out of the range. Executors can override this to enqueue all the tasks with a single
+    //! synchronization; by default, the tasks are enqueued one by one.
+    virtual void enqueueBulk(Task* first, Task* last, TaskPriority prio) {
+        for (; first != last; ++first)
+            enqueue(std::move(*first), prio);
+    }
+
+    //! Checks if the current thread is one of the threads executing the tasks of this executor.
+    //! Executors that can't tell (or that don't have threads of their own) return false.
+    virtual bool isWorkerThread() const { return false; }
 };
 
 using TaskExecutorPtr = std::shared_ptr<TaskExecutor>;
+
+namespace detail {
+//! Maps any list of types to void, like std::void_t from C++17; used for detecting if expressions
+//! are valid. Goes through a struct, so that the unused arguments still take part in SFINAE.
+template <typename...>
+struct makeVoid {
+    using type = void;
+};
+template <typename... Ts>
+using voidT = typename makeVoid<Ts...>::type;
+} // namespace detail
+
+//! Checks if E can be used as an executor, i.e., if it has an enqueue(Task, TaskPriority) function;
+//! the result of enqueue() is ignored. The executors derived from TaskExecutor satisfy this; the
+//! static executors (e.g., StaticSerializer) satisfy it without any virtual functions.
+template <typename E, typename = void>
+struct isTaskExecutor : std::false_type {};
+template <typename E>
+struct isTaskExecutor<E,
+        detail::voidT<decltype(
+                std::declval<E&>().enqueue(std::declval<Task>(), TaskPriority::normal))>>
+    : std::true_type {};
+
+namespace detail {
+template <typename E>
+auto isWorkerThreadOf(const E& executor, int) -> decltype(executor.isWorkerThread()) {
+    return executor.isWorkerThread();
+}
+template <typename E>
+bool isWorkerThreadOf(const E&, long) {
+    return false;
+}
+} // namespace detail
+
+//! Checks if the current thread is one of the worker threads of the given executor. Works for the
+//! static executors too; the ones without an isWorkerThread() function are considered to not have
+//! worker threads.
+template <typename E>
+bool isWorkerThreadOf(const E& executor) {
+    return detail::isWorkerThreadOf(executor, 0);
+}
+
+//! Exposes a static executor as a TaskExecutor, so that it can be used where a TaskExecutorPtr is
+//! expected. The adapter owns the executor.
+template <typename E>
+class TaskExecutorAdapter : public TaskExecutor {
+    static_assert(isTaskExecutor<E>::value, "the adapted type must be an executor");
+
+public:
+    template <typename... Args>
+    explicit TaskExecutorAdapter(Args&&... args)
+        : executor_(std::forward<Args>(args)...) {}
+
+    //! Returns the adapted executor
+    E& executor() { return executor_; }
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) override { executor_.enqueue(std::move(t), prio); }
+    bool isWorkerThread() const override { return isWorkerThreadOf(executor_); }
+
+private:
+    E executor_;
+};
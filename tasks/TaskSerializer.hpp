@@ -1,27 +1,70 @@
 #pragma once
 
 #include "TaskExecutor.hpp"
+#include "TaskSerializerCore.hpp"
 
-#include "tbb/concurrent_queue.h"
-#include "tbb/atomic.h"
-
+/**
+ * @brief      Executor that ensures that its tasks are executed one at a time.
+ *
+ * The tasks are executed on a base executor, but never in parallel; thus, they can access the same
+ * data without additional synchronization.
+ *
+ * Higher priority tasks jump ahead of the lower priority tasks that are waiting in the serializer;
+ * tasks with the same priority are executed in the order they were enqueued.
+ *
+ * The serializer can be bounded, by giving it a capacity in the options; when full, it applies the
+ * configured OverflowPolicy to the new tasks. Use tryEnqueue() to find out what happened to a task.
+ * enqueue() has no way to report a rejected task, so it asserts that none is rejected; with the
+ * reject policy, the producers need to call tryEnqueue().
+ *
+ * Destroying the serializer waits for its drain in progress, if any, to finish; as the drain keeps
+ * going while there are tasks in the serializer, the serializer must not be destroyed from one of
+ * its own tasks.
+ *
+ * @see StaticSerializer, for a serializer whose base executor is known at compile time
+ */
 class TaskSerializer : public TaskExecutor {
 public:
-    TaskSerializer(TaskExecutorPtr executor);
+    //! Upper limit for the number of tasks drained in one hop, regardless of the options.
+    //! Ensures that a busy serializer cannot starve other tasks from the base executor.
+    static constexpr int maxTasksPerHopLimit = TaskSerializerCore::maxTasksPerHopLimit;
+
+    TaskSerializer(TaskExecutorPtr executor, TaskSerializerOptions options = {});
+    ~TaskSerializer();
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) override;
+
+    using TaskExecutor::enqueueBulk;
+    //! Enqueues all the tasks with a single operation on our queue
+    void enqueueBulk(Task* first, Task* last, TaskPriority prio) override;
 
-    void enqueue(Task t) override;
+    //! Enqueues a task, applying the overflow policy if the serializer is bounded and full.
+    //! With the suspend policy, 'resume' is enqueued on the base executor once the task enters the
+    //! serializer; the producer should stop producing until then. The continuation may start even
+    //! before this returns, so the producer shouldn't touch its state after being suspended.
+    EnqueueStatus tryEnqueue(
+            Task t, TaskPriority prio = TaskPriority::normal, Task resume = nullptr);
+
+    //! Returns the number of tasks in the serializer, if bounded; zero otherwise
+    std::size_t depth() const { return core_.depth(); }
+
+#if TASKS_INSTRUMENTATION
+    //! Returns the current values of the counters of this serializer
+    ExecutorCountersSnapshot counters() const { return core_.counters(); }
+#endif
 
 private:
     //! The base executor we are using for executing the tasks passed to the serializer
     TaskExecutorPtr baseExecutor_;
-    //! Queue of tasks that are not yet in execution
-    tbb::concurrent_queue<Task> standbyTasks_;
-    //! Indicates the number of tasks in the standby queue
-    tbb::atomic<int> count_{0};
-
-    //! Enqueues for execution the first task in our standby queue
-    void enqueueFirst();
+    //! The queue of the serializer, and the logic of executing the tasks
+    TaskSerializerCore core_;
 
-    //! Called when we finished executing one task, to continue with other tasks
-    void onTaskDone();
+    //! Starts draining our queue, after finding the serializer idle. Drains on the current thread
+    //! if allowed, otherwise enqueues a drain task.
+    void startDrain(TaskPriority prio);
+    //! Enqueues on the base executor a task that drains our queue
+    void enqueueDrain(TaskPriority prio);
+    //! Executes tasks from our queue; called on the base executor
+    void drain();
 };
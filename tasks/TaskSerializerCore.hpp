@@ -0,0 +1,192 @@
+#pragma once
+
+#include "Task.hpp"
+#include "TaskExecutor.hpp"
+#include "MpscQueue.hpp"
+#include "Instrumentation.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+//! What a bounded serializer does with a task that is enqueued while the serializer is full
+enum class OverflowPolicy {
+    //! The task is dropped; the caller finds out from the returned status
+    reject,
+    //! The task is executed right away on the caller's thread, outside of the serializer. The task
+    //! doesn't get exclusive access, so this is only suitable for tasks that don't need it.
+    runInline,
+    //! The task is kept aside until there is room for it, and the producer is suspended; once the
+    //! task enters the serializer, the producer's continuation is enqueued on the base executor
+    suspend,
+};
+
+//! The outcome of enqueueing a task into a serializer
+enum class EnqueueStatus {
+    //! The task was added to the serializer
+    enqueued,
+    //! The serializer was full, and the task was dropped
+    rejected,
+    //! The serializer was full, and the task was executed on the caller's thread
+    ranInline,
+    //! The serializer was full; the task will be added later, and then the producer resumed
+    suspended,
+};
+
+//! Options that control how a TaskSerializer executes its tasks
+struct TaskSerializerOptions {
+    //! The maximum number of tasks to execute in one hop on the base executor, before yielding.
+    //! With the default value, each task is executed in a separate base-executor task.
+    int maxTasksPerHop{1};
+    //! The maximum amount of time to keep draining tasks in one hop, before yielding.
+    //! Zero means that only maxTasksPerHop limits the draining.
+    std::chrono::microseconds timeBudget{0};
+    //! The maximum number of tasks in the serializer (waiting, or in execution); zero means that
+    //! the serializer is not bounded
+    std::size_t capacity{0};
+    //! What to do with the tasks enqueued while a bounded serializer is full
+    OverflowPolicy overflowPolicy{OverflowPolicy::reject};
+    //! If true, a task enqueued into an idle serializer from a worker thread of the base executor
+    //! is executed right away, on the enqueuing thread, instead of going through the base executor.
+    //! Low priority tasks are never executed this way.
+    bool tryRunInline{false};
+};
+
+/**
+ * @brief      The queue of a serializer, and the logic of executing its tasks one at a time.
+ *
+ * Doesn't know anything about the base executor; the serializers built on top of it only need to
+ * schedule the drain tasks on their base executors, when asked to. This way, the same logic is
+ * used both by TaskSerializer (with a polymorphic base executor) and by StaticSerializer (with a
+ * base executor known at compile time).
+ *
+ * Higher priority tasks jump ahead of the lower priority tasks that are waiting in the serializer;
+ * tasks with the same priority are executed in the order they were enqueued.
+ */
+class TaskSerializerCore {
+public:
+    //! Upper limit for the number of tasks drained in one hop, regardless of the options.
+    //! Ensures that a busy serializer cannot starve other tasks from the base executor.
+    static constexpr int maxTasksPerHopLimit = 1024;
+    //! The maximum number of drains executed on the enqueuing thread that can be nested on a thread
+    //! (e.g., a task of one serializer enqueueing into another serializer, which drains inline)
+    static constexpr int maxInlineDepth = 8;
+
+    explicit TaskSerializerCore(TaskSerializerOptions options = {});
+    ~TaskSerializerCore();
+
+    TaskSerializerCore(const TaskSerializerCore&) = delete;
+    TaskSerializerCore& operator=(const TaskSerializerCore&) = delete;
+
+    //! Adds a task to the serializer.
+    //! Returns true if the serializer was idle; the caller needs to schedule a drain task, with the
+    //! priority of the given task.
+    bool push(Task t, TaskPriority prio);
+    //! Adds the tasks in the range [first, last) to the serializer, all at once, with the given
+    //! priority. Returns true if the serializer was idle, just like push().
+    bool pushBulk(Task* first, Task* last, TaskPriority prio);
+
+    //! Indicates whether the serializer has a limited capacity
+    bool isBounded() const { return bool(bounded_); }
+    //! Adds a task to a bounded serializer, if there is room for it; otherwise applies the overflow
+    //! policy. With the suspend policy, 'resume' is handed back through takeResumedProducer(), once
+    //! the task enters the serializer. Sets 'wasIdle' like the result of push().
+    EnqueueStatus pushBounded(Task t, TaskPriority prio, Task resume, bool& wasIdle);
+    //! Takes the continuation of a suspended producer whose task entered the serializer; the
+    //! caller needs to enqueue it on the base executor. Returns false if there is none.
+    bool takeResumedProducer(Task& resume);
+    //! Returns the number of tasks in a bounded serializer, waiting or in execution; the tasks of
+    //! the suspended producers are not counted. Always zero for unbounded serializers.
+    std::size_t depth() const;
+
+    //! Checks if a drain task with the given priority can be replaced by draining on the current
+    //! thread; the caller still needs to check that it's a worker thread of the base executor
+    bool canDrainInline(TaskPriority prio) const {
+        return tryRunInline_ && prio != TaskPriority::low;
+    }
+    //! Marks the start of a drain on the enqueuing thread. Returns false, without marking anything,
+    //! if too many inline drains are already nested on this thread.
+    static bool enterInlineDrain();
+    //! Marks the end of a drain on the enqueuing thread, started with enterInlineDrain()
+    static void exitInlineDrain();
+
+    //! Marks the start of a drain hop, either enqueued on the base executor or executed inline.
+    //! A hop that schedules the next one hands it over its mark, instead of calling endDrain().
+    void beginDrain() { numActiveDrains_.fetch_add(1, std::memory_order_relaxed); }
+    //! Marks the end of a drain hop; must be the last access of the hop to the serializer
+    void endDrain() { numActiveDrains_.fetch_sub(1, std::memory_order_release); }
+    //! Waits until there are no drain hops in progress. The drain tasks refer to the serializer,
+    //! so the serializers call this before they are destroyed.
+    void waitForDrains() const;
+
+    //! Pops tasks from our standby queue and executes them, until the queue is empty or we exceed
+    //! the limits of one hop; called on the base executor.
+    //! Returns true if the caller needs to schedule another drain task, with priority 'nextPrio'.
+    bool drain(TaskPriority& nextPrio);
+
+#if TASKS_INSTRUMENTATION
+    //! Returns the current values of the counters of this serializer
+    ExecutorCountersSnapshot counters() const { return counters_.snapshot(); }
+#endif
+
+private:
+    //! A task, as kept in our standby queue
+    struct TaskNode : MpscNode {
+        Task task_;
+        TaskPriority priority_;
+        //! The next node in the list of pending tasks with the same priority
+        TaskNode* nextPending_{nullptr};
+#if TASKS_INSTRUMENTATION
+        //! The time at which the task was enqueued
+        std::int64_t enqueueTimeNs_{ExecutorCounters::nowNs()};
+#endif
+
+        TaskNode(Task t, TaskPriority prio)
+            : task_(std::move(t))
+            , priority_(prio) {}
+    };
+
+    struct BoundedState;
+
+    //! List of tasks taken out of the standby queue, but not yet executed
+    struct PendingList {
+        TaskNode* first_{nullptr};
+        TaskNode* last_{nullptr};
+    };
+
+    //! Queue of tasks that are not yet in execution.
+    //! Also keeps track of whether there is a drain task active for this serializer.
+    MpscQueue standbyTasks_;
+    //! The tasks taken out of the standby queue by the drain task, one list per priority.
+    //! Only accessed by the drain task.
+    PendingList pendingTasks_[numTaskPriorities];
+    //! The maximum number of tasks to execute in one hop
+    int maxTasksPerHop_;
+    //! The maximum duration of one hop; zero if not limited
+    std::chrono::microseconds timeBudget_;
+    //! True if we can drain on the enqueuing thread
+    bool tryRunInline_;
+    //! The capacity, the depth and the suspended producers; null if the serializer is not bounded
+    std::unique_ptr<BoundedState> bounded_;
+    //! The number of drain hops that are scheduled or running
+    std::atomic<int> numActiveDrains_{0};
+#if TASKS_INSTRUMENTATION
+    //! Counters about the tasks that go through this serializer
+    ExecutorCounters counters_;
+#endif
+
+    //! Moves all the available tasks from the standby queue to the pending lists
+    void fetchPendingTasks();
+    //! Takes the highest priority pending task; returns null if there are no pending tasks
+    TaskNode* popPendingTask();
+    //! Checks if there are tasks in the pending lists
+    bool hasPendingTasks() const;
+    //! Returns the priority of the highest priority pending task (or normal if there are none)
+    TaskPriority topPendingPriority() const;
+    //! Takes one of the free places of a bounded serializer; returns false if it is full
+    bool tryReserveSlot();
+    //! Called when a task of a bounded serializer completes; hands over its place to the first
+    //! suspended producer, if there is one
+    void releaseSlot();
+};
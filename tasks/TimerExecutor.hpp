@@ -0,0 +1,119 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+#include "MpscQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief      Executor that can delay the execution of tasks.
+ *
+ * The delayed tasks are kept in a hierarchical timing wheel, managed by a single timer thread. When
+ * the time of a task comes, the task is handed to the target executor; the timer thread never
+ * executes tasks itself. This way, any number of tasks can wait without blocking worker threads.
+ *
+ * The time is measured in ticks; a task is never executed before its time, but it may be executed
+ * up to one tick later. Tasks enqueued without delay go directly to the target executor.
+ *
+ * The tasks that are still waiting when the executor is destroyed are discarded.
+ */
+class TimerExecutor : public TaskExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    //! Creates the executor, handing the tasks to the given executor when their time comes
+    explicit TimerExecutor(TaskExecutorPtr executor,
+            Clock::duration tickDuration = std::chrono::milliseconds(1));
+    ~TimerExecutor();
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) override;
+    using TaskExecutor::enqueueBulk;
+    void enqueueBulk(Task* first, Task* last, TaskPriority prio) override;
+    //! Checks if the current thread is a worker thread of the target executor
+    bool isWorkerThread() const override;
+
+    //! Enqueues the task in the target executor at the given time
+    void enqueueAt(Clock::time_point time, Task t, TaskPriority prio = TaskPriority::normal);
+
+    //! Enqueues the task in the target executor after the given delay
+    template <typename Rep, typename Period>
+    void enqueueAfter(std::chrono::duration<Rep, Period> delay, Task t,
+            TaskPriority prio = TaskPriority::normal) {
+        enqueueAt(Clock::now() + std::chrono::duration_cast<Clock::duration>(delay), std::move(t),
+                prio);
+    }
+
+private:
+    //! A delayed task
+    struct TimerNode : MpscNode {
+        Task task_;
+        TaskPriority priority_;
+        //! The tick at which the task needs to be executed
+        std::uint64_t expiryTick_;
+        //! The next node in the same slot of the wheel
+        TimerNode* nextInSlot_{nullptr};
+
+        TimerNode(Task t, TaskPriority prio, std::uint64_t expiryTick)
+            : task_(std::move(t))
+            , priority_(prio)
+            , expiryTick_(expiryTick) {}
+    };
+
+    //! The number of bits in a slot index
+    static constexpr int slotBits = 6;
+    //! The number of slots in each level of the wheel
+    static constexpr int numSlots = 1 << slotBits;
+    //! The number of levels of the wheel. Level L covers delays up to numSlots^(L+1) ticks.
+    //! Longer delays are placed at the top level and re-inserted when they get there.
+    static constexpr int numLevels = 4;
+
+    //! The executor that runs the tasks
+    TaskExecutorPtr targetExecutor_;
+    //! The duration of a tick
+    Clock::duration tickDuration_;
+    //! The time corresponding to tick zero
+    Clock::time_point startTime_;
+
+    //! The tasks added by the producers, not yet placed in the wheel.
+    //! Marked as idle when the timer thread waits without any timers.
+    MpscQueue newTimers_;
+    //! The slots of the wheel; only accessed by the timer thread
+    TimerNode* wheel_[numLevels][numSlots] = {};
+    //! The number of tasks in the wheel
+    std::size_t numTimers_{0};
+    //! The current tick; all the tasks with an earlier expiry tick are dispatched
+    std::uint64_t currentTick_{0};
+
+    //! Set when the executor is destroyed
+    std::atomic<bool> stopping_{false};
+    //! Used to wake up the timer thread
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    //! True if the timer thread needs to wake up; protected by mutex_
+    bool wakeUp_{false};
+    //! The thread that manages the timers
+    std::thread timerThread_;
+
+    //! The body of the timer thread
+    void run();
+    //! Moves the tasks from newTimers_ into the wheel (or dispatches them, if already expired)
+    void fetchNewTimers();
+    //! Places the node in the wheel, according to its expiry tick
+    void insert(TimerNode* node);
+    //! Advances the current tick by one, dispatching the expired tasks
+    void advanceTick();
+    //! Re-inserts all the nodes from the given slot; they will move to lower levels
+    void cascade(int level, int slot);
+    //! Hands the task of the node to the target executor, and deletes the node
+    void dispatch(TimerNode* node);
+    //! Returns the number of complete ticks since the start
+    std::uint64_t elapsedTicks() const;
+    //! Returns the tick for the given time, rounded up
+    std::uint64_t tickFor(Clock::time_point time) const;
+};
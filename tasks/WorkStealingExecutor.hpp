@@ -0,0 +1,89 @@
+#pragma once
+
+#include "TaskExecutor.hpp"
+#include "ChaseLevDeque.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief      Thread-pool executor that uses work stealing to balance the tasks between workers.
+ *
+ * Each worker thread has its own deque of tasks. Tasks enqueued from a worker thread are pushed to
+ * the deque of that worker, and will be executed in LIFO order; this way, continuations tend to
+ * stay on the same thread, with hot caches. Every few tasks, a worker takes the oldest task of its
+ * deque instead, so a task that keeps enqueueing itself cannot starve the older ones. Tasks
+ * enqueued from other threads are placed in a global injection queue. Workers that run out of
+ * tasks steal from the deques of randomly chosen workers.
+ *
+ * Low priority tasks always go to the back of the injection queue; high priority tasks enqueued
+ * from external threads go to the front of it.
+ *
+ * Doesn't depend on TBB.
+ */
+class WorkStealingExecutor : public TaskExecutor {
+public:
+    //! Creates the executor with the given number of worker threads.
+    //! If the number of threads is not positive, use the number of hardware threads.
+    explicit WorkStealingExecutor(int numThreads = 0);
+    //! Creates the executor with worker threads pinned to the given set of CPUs.
+    //! If the set of CPUs is empty, the threads are not pinned.
+    WorkStealingExecutor(int numThreads, std::vector<int> cpus);
+    ~WorkStealingExecutor();
+
+    using TaskExecutor::enqueue;
+    void enqueue(Task t, TaskPriority prio) final;
+
+    using TaskExecutor::enqueueBulk;
+    //! Enqueues all the tasks while holding the injection queue lock once, and wakes up at most as
+    //! many workers as there are tasks
+    void enqueueBulk(Task* first, Task* last, TaskPriority prio) final;
+
+    //! Returns the number of worker threads of this executor
+    int numThreads() const { return int(workers_.size()); }
+
+    //! Checks if the current thread is one of the worker threads of this executor
+    bool isWorkerThread() const final;
+
+private:
+    struct Worker;
+
+    //! The worker corresponding to the current thread; null if the current thread is not a worker
+    static thread_local Worker* currentWorker_;
+
+    //! The workers of this executor
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    //! Queue with the tasks enqueued from outside our worker threads
+    std::deque<Task*> injectionQueue_;
+    //! Mutex protecting the injection queue
+    std::mutex injectionMutex_;
+    //! The size of the injection queue; allows checking for work without locking
+    std::atomic<std::size_t> injectionSize_{0};
+
+    //! The number of workers sleeping, waiting for work
+    std::atomic<int> numSleeping_{0};
+    //! Mutex used for putting the workers to sleep
+    std::mutex sleepMutex_;
+    //! Condition variable used to wake up sleeping workers
+    std::condition_variable wakeUpCond_;
+    //! Set when the executor is destroyed
+    std::atomic<bool> stopping_{false};
+
+    //! The loop of a worker thread
+    void workerLoop(Worker& worker);
+    //! Finds a task for the given worker to execute; returns null if no task was found
+    Task* findTask(Worker& worker);
+    //! Takes a task from the injection queue; returns null if the queue is empty
+    Task* popInjected();
+    //! Tries to steal a task from the workers, starting with a random one
+    Task* steal(Worker& thief);
+    //! Checks if there are tasks that could be executed
+    bool hasTasks() const;
+    //! Wakes up to 'numTasks' sleeping workers, if there are any
+    void notifyWorkers(std::size_t numTasks = 1);
+};
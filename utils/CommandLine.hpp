@@ -0,0 +1,39 @@
+#pragma once
+
+// Helpers for parsing the command lines of the benchmarks and of the example programs
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//! If 'arg' starts with 'prefix', stores the rest of it in 'value' and returns true
+inline bool matchArg(const char* arg, const char* prefix, std::string& value) {
+    std::size_t len = strlen(prefix);
+    if (strncmp(arg, prefix, len) != 0)
+        return false;
+    value = arg + len;
+    return true;
+}
+
+//! Parses a comma-separated list of names
+inline std::vector<std::string> parseNameList(const std::string& str) {
+    std::vector<std::string> res;
+    std::size_t pos = 0;
+    while (pos < str.size()) {
+        std::size_t end = str.find(',', pos);
+        if (end == std::string::npos)
+            end = str.size();
+        res.push_back(str.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return res;
+}
+
+//! Parses a comma-separated list of integers
+inline std::vector<int> parseIntList(const std::string& str) {
+    std::vector<int> res;
+    for (const auto& item : parseNameList(str))
+        res.push_back(std::atoi(item.c_str()));
+    return res;
+}